@@ -8,12 +8,16 @@ Item {
 
     RingConnector {
         id: ring
-        Component.onCompleted: startDeviceDiscovery();
+        Component.onCompleted: {
+            attachStage("recorder", recorder)
+            attachStage("spectrum", spectrum)
+            startDeviceDiscovery()
+        }
 
         allowAutoreconnect: autoreconnectCheckbox.checked
         mouseControlEnabled: mouseControlCheckbox.checked
 
-        onAccelerometerDataReady: (value) => {
+        onAccelerometerDataReady: (value, timestamp) => {
             xLabel.text = "X: " + value.x;
             yLabel.text = "Y: " + value.y;
             zLabel.text = "Z: " + value.z;
@@ -38,6 +42,22 @@ Item {
         }
     }
 
+    SpectrumAnalyzer {
+        id: spectrum
+        sampleRate: ring.samplePeriod > 0 ? 1000 / ring.samplePeriod : 25
+    }
+
+    DataRecorder {
+        id: recorder
+        recording: recordCheckbox.checked
+
+        onError: (message) => {
+            statusLabel.text = "Error: " + message
+            statusLabel.color = "#FF5555"
+            console.log("[ERROR]", message)
+        }
+    }
+
     Item {
         id: battIndicator
         width: 64
@@ -184,6 +204,46 @@ Item {
             }
         }
 
+        // Band power of the accelerometer, log scaled
+        RowLayout {
+            Layout.alignment: Qt.AlignHCenter
+            spacing: 20
+
+            Repeater {
+                model: ["Activity", "Tremor", "Vibration"]
+
+                ColumnLayout {
+                    required property int index
+                    required property string modelData
+                    readonly property real power: spectrum.bandPowers[index] ?? 0
+
+                    Rectangle {
+                        Layout.preferredWidth: 80
+                        Layout.preferredHeight: 8
+                        color: "#333"
+
+                        Rectangle {
+                            width: parent.width * Math.min(1, Math.log10(1 + power) / 5)
+                            height: parent.height
+                            color: "#2CDE85"
+                        }
+                    }
+                    Label {
+                        Layout.alignment: Qt.AlignHCenter
+                        text: modelData
+                        color: "#AAA"
+                        font.pixelSize: 12
+                    }
+                }
+            }
+        }
+
+        RecordingOverview {
+            Layout.fillWidth: true
+            Layout.preferredHeight: 110
+            dataRecorder: recorder
+        }
+
         // Battery Info
         Label {
             id: batteryLabel
@@ -208,6 +268,11 @@ Item {
                 text: "mouse control"
             }
 
+            CheckBox {
+                id: recordCheckbox
+                text: "record"
+            }
+
             Button {
                 text: "Calibrate (Tare)"
                 onClicked: {
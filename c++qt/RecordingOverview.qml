@@ -0,0 +1,156 @@
+import QtQuick
+import QtQuick.Controls
+import QtQuick.Layouts
+import R02DataExplorer
+
+// Min/max envelope of the current or an earlier recording, read from its
+// index. Scroll to zoom around the cursor, drag to scrub. While recording the
+// view follows the end unless it has been scrubbed away from it.
+ColumnLayout {
+    id: overview
+    required property DataRecorder dataRecorder
+
+    property real viewStart: 0
+    property real viewEnd: 0
+    property bool following: true
+    property bool zoomed: false
+    property var summaries: []
+    readonly property real minSpanMs: 2000
+    readonly property var axisColors: ["#FF5555", "#2CDE85", "#5599FF"]
+
+    spacing: 4
+
+    function showRange(start, span) {
+        const total = dataRecorder.endTime - dataRecorder.startTime
+        if (total <= 0) {
+            summaries = []
+            canvas.requestPaint()
+            return
+        }
+        span = Math.min(total, Math.max(minSpanMs, span))
+        start = Math.max(dataRecorder.startTime, Math.min(start, dataRecorder.endTime - span))
+        viewStart = start
+        viewEnd = start + span
+        zoomed = span < total
+        following = viewEnd >= dataRecorder.endTime
+        summaries = dataRecorder.overview(viewStart, viewEnd, Math.max(1, Math.floor(canvas.width / 2)))
+        canvas.requestPaint()
+    }
+
+    function showAll() {
+        showRange(dataRecorder.startTime, dataRecorder.endTime - dataRecorder.startTime)
+    }
+
+    Connections {
+        target: overview.dataRecorder
+        // A new recording, an earlier one opened, or the first sample recorded.
+        function onStartTimeChanged() { overview.showAll() }
+        // Once per flush while samples come in, never while no ring is
+        // connected, so following the recording needs no timer of its own.
+        function onEndTimeChanged() {
+            if (!overview.following)
+                return
+            if (overview.zoomed)
+                overview.showRange(overview.dataRecorder.endTime - (overview.viewEnd - overview.viewStart),
+                                   overview.viewEnd - overview.viewStart)
+            else
+                overview.showAll()
+        }
+    }
+
+    RowLayout {
+        Layout.fillWidth: true
+
+        ComboBox {
+            id: recordingPicker
+            Layout.fillWidth: true
+            enabled: !overview.dataRecorder.recording
+            textRole: "name"
+            valueRole: "path"
+            displayText: overview.dataRecorder.fileName.length > 0
+                         ? overview.dataRecorder.fileName.split("/").pop() : "No recording"
+            onPressedChanged: if (pressed) model = overview.dataRecorder.recordings()
+            onActivated: overview.dataRecorder.openRecording(currentValue)
+        }
+
+        Label {
+            text: overview.summaries.length > 0
+                  ? new Date(overview.viewStart).toLocaleString(Qt.locale(), Locale.ShortFormat) + " – "
+                    + new Date(overview.viewEnd).toLocaleTimeString(Qt.locale(), Locale.ShortFormat)
+                  : ""
+            color: "#AAA"
+            font.pixelSize: 12
+        }
+
+        Button {
+            text: "All"
+            enabled: overview.zoomed
+            onClicked: overview.showAll()
+        }
+    }
+
+    Canvas {
+        id: canvas
+        Layout.fillWidth: true
+        Layout.fillHeight: true
+
+        onWidthChanged: if (overview.summaries.length > 0) overview.showRange(overview.viewStart, overview.viewEnd - overview.viewStart)
+
+        onPaint: {
+            const ctx = getContext("2d")
+            ctx.fillStyle = "#111"
+            ctx.fillRect(0, 0, width, height)
+
+            const rows = overview.summaries
+            let low = Infinity
+            let high = -Infinity
+            for (const row of rows) {
+                if (row.count === 0)
+                    continue
+                low = Math.min(low, row.min.x, row.min.y, row.min.z)
+                high = Math.max(high, row.max.x, row.max.y, row.max.z)
+            }
+            if (!(high > low))
+                return
+
+            const toY = value => height - (value - low) / (high - low) * height
+            const component = (vector, axis) => axis === 0 ? vector.x : axis === 1 ? vector.y : vector.z
+            const step = width / rows.length
+            ctx.lineWidth = Math.max(1, step)
+            ctx.globalAlpha = 0.6
+            for (let axis = 0; axis < 3; ++axis) {
+                ctx.strokeStyle = overview.axisColors[axis]
+                ctx.beginPath()
+                for (let i = 0; i < rows.length; ++i) {
+                    if (rows[i].count === 0)
+                        continue
+                    const x = (i + 0.5) * step
+                    ctx.moveTo(x, toY(component(rows[i].max, axis)))
+                    ctx.lineTo(x, toY(component(rows[i].min, axis)) + 1)
+                }
+                ctx.stroke()
+            }
+        }
+
+        MouseArea {
+            anchors.fill: parent
+            property real pressX: 0
+            property real pressStart: 0
+
+            onPressed: (mouse) => {
+                pressX = mouse.x
+                pressStart = overview.viewStart
+            }
+            onPositionChanged: (mouse) => {
+                const span = overview.viewEnd - overview.viewStart
+                overview.showRange(pressStart - (mouse.x - pressX) / width * span, span)
+            }
+            onWheel: (wheel) => {
+                const span = overview.viewEnd - overview.viewStart
+                const newSpan = span * Math.pow(0.8, wheel.angleDelta.y / 120)
+                const anchor = overview.viewStart + wheel.x / width * span
+                overview.showRange(anchor - wheel.x / width * newSpan, newSpan)
+            }
+        }
+    }
+}
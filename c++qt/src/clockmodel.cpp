@@ -0,0 +1,190 @@
+#include "clockmodel.h"
+#include <cmath>
+#include <limits>
+
+ClockModel::ClockModel()
+{
+}
+
+double ClockModel::addArrival(double arrivalMs)
+{
+    if (m_x < 0) {
+        restart(arrivalMs);
+        m_lastTimestamp = arrivalMs;
+        return arrivalMs;
+    }
+
+    const qint64 x = m_x + 1;
+    const double y = arrivalMs - m_anchorMs;
+
+    // A gap far beyond the expected next sample: the ring stopped or we lost
+    // a chunk of the stream. Start over from this arrival.
+    if (m_period > 0) {
+        const double late = y - (fitted(x) + m_floor);
+        if (late > qMax(MIN_GAP_MS, GAP_PERIODS * m_period)) {
+            m_relocks++;
+            restart(arrivalMs);
+            m_lastTimestamp = qMax(arrivalMs, m_lastTimestamp + 1e-3);
+            return m_lastTimestamp;
+        }
+    }
+
+    m_sw = FORGETTING * m_sw + 1;
+    m_sx = FORGETTING * m_sx + x;
+    m_sy = FORGETTING * m_sy + y;
+    m_sxx = FORGETTING * m_sxx + double(x) * x;
+    m_sxy = FORGETTING * m_sxy + double(x) * y;
+    m_x = x;
+    m_count++;
+
+    m_recent[m_recentNext] = { x, y };
+    m_recentNext = (m_recentNext + 1) % m_recent.size();
+    m_recentCount = qMin(m_recentCount + 1, int(m_recent.size()));
+    const bool renumbered = checkForLoss();
+    refit();
+    if (renumbered) {
+        // The envelope was followed under the misnumbered fit, find it again.
+        m_floor = std::numeric_limits<double>::max();
+        for (const Arrival &arrival : m_recent)
+            m_floor = qMin(m_floor, arrival.y - fitted(arrival.x));
+    }
+
+    double timestamp = arrivalMs;
+    if (m_period > 0) {
+        // m_x rather than x, checkForLoss() may have renumbered this arrival.
+        const double residual = y - fitted(m_x);
+        m_sr2 = FORGETTING * m_sr2 + residual * residual;
+        m_floor = qMin(residual, m_floor + FLOOR_RISE_MS);
+        timestamp = m_anchorMs + fitted(m_x) + m_floor;
+
+        // Long-run average period for driftPpm(), from where the envelope has
+        // settled, between arrivals checkForLoss() won't renumber anymore.
+        const qint64 settled = m_recent[(m_recentNext + LOSS_WINDOW - 1) % m_recent.size()].x;
+        if (m_count == REFERENCE_SAMPLES) {
+            m_driftStartX = settled;
+            m_driftStartMs = m_anchorMs + fitted(settled) + m_floor;
+            m_driftSamples = 0;
+        }
+        else if (m_driftSamples >= 0) {
+            m_driftSamples = settled - m_driftStartX;
+            m_driftEndMs = m_anchorMs + fitted(settled) + m_floor;
+        }
+    }
+
+    if (m_x >= REBASE_SAMPLES)
+        rebase();
+
+    m_lastTimestamp = qMax(timestamp, m_lastTimestamp + 1e-3);
+    return m_lastTimestamp;
+}
+
+void ClockModel::reset()
+{
+    m_x = -1;
+    m_count = 0;
+    m_driftSamples = -1;
+}
+
+double ClockModel::driftPpm() const
+{
+    const double span = m_driftEndMs - m_driftStartMs;
+    if (m_nominalPeriod <= 0 || m_driftSamples <= 0 || span < DRIFT_MIN_SPAN_MS)
+        return 0;
+    return (span / m_driftSamples / m_nominalPeriod - 1.0) * 1e6;
+}
+
+void ClockModel::refit()
+{
+    // Until we have enough samples for a stable slope, keep using the period
+    // from before the last restart (if any) and fit only the intercept.
+    const double den = m_sw * m_sxx - m_sx * m_sx;
+    if (m_count >= MIN_LOCK_SAMPLES && den > 0)
+        m_period = (m_sw * m_sxy - m_sx * m_sy) / den;
+    if (m_period > 0)
+        m_intercept = (m_sy - m_period * m_sx) / m_sw;
+}
+
+bool ClockModel::checkForLoss()
+{
+    const double period = m_nominalPeriod > 0 ? m_nominalPeriod : m_period;
+    const int size = m_recent.size();
+    if (m_recentCount < size || period <= 0)
+        return false;
+
+    // Lower envelopes of the newer and the older window, newest first.
+    double after = std::numeric_limits<double>::max();
+    double before = after;
+    for (int i = 1; i <= size; ++i) {
+        const Arrival &arrival = m_recent[(m_recentNext - i + size) % size];
+        double &envelope = i <= LOSS_WINDOW ? after : before;
+        envelope = qMin(envelope, arrival.y - period * arrival.x);
+    }
+    const double step = after - before;
+    if (step < LOSS_STEP_PERIODS * period)
+        return false;
+
+    // Renumber the newer window, newest first. The sums are linear in each
+    // sample's contribution, weighted by FORGETTING per arrival since. A run
+    // of batched arrivals just before the loss can raise the newer envelope
+    // too; those would land below the older one, so they keep their numbers.
+    const qint64 lost = qRound64(step / period);
+    double weight = 1;
+    for (int i = 1; i <= LOSS_WINDOW; ++i, weight *= FORGETTING) {
+        Arrival &arrival = m_recent[(m_recentNext - i + size) % size];
+        if (arrival.y - period * (arrival.x + lost) < before - LOSS_EARLY_MS)
+            break;
+        m_sx += weight * lost;
+        m_sxx += weight * (2.0 * arrival.x * lost + double(lost) * lost);
+        m_sxy += weight * lost * arrival.y;
+        arrival.x += lost;
+    }
+    m_x += lost;
+    m_lost += lost;
+    return true;
+}
+
+double ClockModel::jitterMs() const
+{
+    return m_sw > 0 ? std::sqrt(m_sr2 / m_sw) : 0;
+}
+
+void ClockModel::restart(double arrivalMs)
+{
+    m_anchorMs = arrivalMs;
+    m_x = 0;
+    m_sw = 1;
+    m_sx = 0;
+    m_sy = 0;
+    m_sxx = 0;
+    m_sxy = 0;
+    m_sr2 = 0;
+    m_intercept = 0;
+    m_floor = 0;
+    m_count = 1;
+    m_restarts++;
+    m_recentCount = 0;
+    m_recentNext = 0;
+    // Samples were lost in the gap, the average can't span it.
+    m_driftSamples = -1;
+}
+
+void ClockModel::rebase()
+{
+    // Move the origin to the current sample so the sums stay well conditioned
+    // over multi-day runs. The fitted line is unchanged by the shift.
+    const double dx = m_x;
+    const double dy = m_period * dx;
+
+    m_sxy = m_sxy - dy * m_sx - dx * m_sy + dx * dy * m_sw;
+    m_sxx = m_sxx - 2 * dx * m_sx + dx * dx * m_sw;
+    m_sx -= dx * m_sw;
+    m_sy -= dy * m_sw;
+
+    m_anchorMs += dy;
+    m_x = 0;
+    m_driftStartX -= qint64(dx);
+    for (Arrival &arrival : m_recent) {
+        arrival.x -= qint64(dx);
+        arrival.y -= dy;
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef CLOCKMODEL_H
+#define CLOCKMODEL_H
+
+#include <QtGlobal>
+#include <array>
+
+// Reconstructs sample timestamps for the ring's accelerometer stream.
+//
+// The ring sends no timestamps, and BLE delivers notifications in batches per
+// connection interval, so arrival times are the true sample times plus a
+// non-negative, jittery delay. We fit arrival time against sample number with
+// an exponentially weighted least squares line (the slope is the ring's sample
+// period in host milliseconds, so it tracks clock drift), then place the line
+// on the lower envelope of the arrivals, which is where the least-delayed
+// packets sit.
+//
+// A lost notification would otherwise be fitted as if no sample were
+// missing, so every arrival after it looks a period late. Batching delays
+// arrivals by up to a connection interval too, but not all of them: each
+// batch ends with a sample sent shortly before it. So the lower envelope of
+// the last LOSS_WINDOW arrivals only steps up by about a period when samples
+// were lost between them and the LOSS_WINDOW before. Their sample numbers are
+// then advanced by the periods in the step, and the fit corrected to match.
+// Steps are measured against the nominal period, which is close enough to
+// count periods over two windows whatever the drift.
+//
+// A gap much longer than the current period (dropout, reconnect) restarts the
+// fit at the new arrival, seeded with the previous period estimate.
+class ClockModel
+{
+public:
+    ClockModel();
+
+    // Feed the host arrival time (ms, monotonic) of the next sample and get
+    // its reconstructed timestamp back. Returned timestamps strictly increase.
+    double addArrival(double arrivalMs);
+
+    // Forget the current lock but keep the period estimate as a prior.
+    void reset();
+
+    // What the ring's clock should give, the reference for driftPpm().
+    void setNominalPeriodMs(double periodMs) { m_nominalPeriod = periodMs; }
+
+    bool locked() const { return m_count >= MIN_LOCK_SAMPLES; }
+    double periodMs() const { return m_period; }
+    // Rate of the ring's clock against the nominal period, ppm, from the
+    // average period since the lock settled. The fitted period only remembers
+    // ~500 samples, too little to resolve ppm through BLE batching jitter, so
+    // this stays 0 until at least DRIFT_MIN_SPAN_MS have been averaged.
+    double driftPpm() const;
+    // RMS of arrival times around the fitted line, ms.
+    double jitterMs() const;
+    int relockCount() const { return m_relocks; }
+    // Samples found missing from the stream without a restart.
+    qint64 lostCount() const { return m_lost; }
+    // Every restart, the first arrival after reset() included.
+    int restartCount() const { return m_restarts; }
+
+private:
+    void restart(double arrivalMs);
+    void rebase();
+    void refit();
+    bool checkForLoss();
+    double fitted(double x) const { return m_intercept + m_period * x; }
+
+    static constexpr int MIN_LOCK_SAMPLES = 16;
+    static constexpr int REFERENCE_SAMPLES = 512;   // Before the drift reference is taken
+    static constexpr double DRIFT_MIN_SPAN_MS = 10 * 60000.0;
+    static constexpr double FORGETTING = 0.998;     // ~500 sample memory
+    static constexpr double FLOOR_RISE_MS = 0.02;   // Per sample, lets the envelope follow later arrivals
+    static constexpr int LOSS_WINDOW = 32;          // Arrivals, spans many connection intervals
+    static constexpr double LOSS_STEP_PERIODS = 0.6; // Batching quantizes the step to less than a period
+    static constexpr double LOSS_EARLY_MS = 2.0;    // Renumbered arrivals may land this far below the envelope
+    static constexpr double GAP_PERIODS = 25.0;
+    static constexpr double MIN_GAP_MS = 1000.0;
+    static constexpr qint64 REBASE_SAMPLES = 4096;
+
+    // Sample number and arrival time relative to the anchor.
+    double m_anchorMs = 0;
+    qint64 m_x = -1;
+
+    // Exponentially weighted sums for the regression.
+    double m_sw = 0;
+    double m_sx = 0;
+    double m_sy = 0;
+    double m_sxx = 0;
+    double m_sxy = 0;
+    double m_sr2 = 0;
+
+    double m_intercept = 0;
+    double m_period = 0;
+    double m_nominalPeriod = 0;
+    // Envelope timestamps at the drift reference and now, and the samples in
+    // between. m_driftStartX is the reference's sample number.
+    qint64 m_driftStartX = 0;
+    double m_driftStartMs = 0;
+    double m_driftEndMs = 0;
+    qint64 m_driftSamples = -1;
+    double m_floor = 0;
+    double m_lastTimestamp = 0;
+
+    // The last 2 * LOSS_WINDOW arrivals, as numbered.
+    struct Arrival {
+        qint64 x;
+        double y;
+    };
+    std::array<Arrival, 2 * LOSS_WINDOW> m_recent;
+    int m_recentCount = 0;
+    int m_recentNext = 0;
+
+    int m_count = 0;
+    int m_relocks = 0;
+    int m_restarts = 0;
+    qint64 m_lost = 0;
+};
+
+#endif // CLOCKMODEL_H
@@ -0,0 +1,254 @@
+#include "datarecorder.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+// Same layout as python/ring.py: raw_data/ring_data_YYYYMMDD_HHMMSS.csv
+const QString DATA_FOLDER = "raw_data";
+
+DataRecorder::DataRecorder(QObject *parent)
+    : QObject(parent)
+{
+}
+
+DataRecorder::~DataRecorder()
+{
+    detachStage();
+    stopRecording();
+}
+
+void DataRecorder::setRecording(bool recording)
+{
+    if (m_recording == recording)
+        return;
+
+    if (recording) {
+        if (!startRecording())
+            return;
+    } else {
+        stopRecording();
+    }
+    emit recordingChanged();
+}
+
+qint64 DataRecorder::startTime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.isOpen() ? m_index.startMs() : 0;
+}
+
+qint64 DataRecorder::endTime() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_index.isOpen() ? m_index.endMs() : 0;
+}
+
+QVariantList DataRecorder::overview(qint64 from, qint64 to, int buckets)
+{
+    QVariantList result;
+    QList<RecordingIndex::Summary> summaries;
+    {
+        QMutexLocker locker(&m_mutex);
+        summaries = m_index.query(from, to, buckets);
+    }
+    result.reserve(summaries.size());
+    for (const RecordingIndex::Summary &summary : summaries) {
+        QVariantMap entry;
+        entry["start"] = summary.startMs;
+        entry["end"] = summary.endMs;
+        entry["count"] = summary.count;
+        entry["min"] = QVariant::fromValue(summary.min);
+        entry["max"] = QVariant::fromValue(summary.max);
+        entry["mean"] = QVariant::fromValue(summary.mean);
+        result.append(entry);
+    }
+    return result;
+}
+
+QVariantList DataRecorder::recordings() const
+{
+    QDir dataDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    if (!dataDir.cd(DATA_FOLDER))
+        return QVariantList();
+
+    QVariantList result;
+    const QFileInfoList files = dataDir.entryInfoList({ "ring_data_*.csv" }, QDir::Files, QDir::Name | QDir::Reversed);
+    for (const QFileInfo &file : files) {
+        if (!QFileInfo::exists(RecordingIndex::indexDirFor(file.filePath())))
+            continue;
+        QVariantMap entry;
+        entry["name"] = file.completeBaseName();
+        entry["path"] = file.filePath();
+        result.append(entry);
+    }
+    return result;
+}
+
+bool DataRecorder::openRecording(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_recording) {
+        locker.unlock();
+        emit error("Cannot open a recording while recording");
+        return false;
+    }
+    if (!m_index.open(fileName)) {
+        const QString message = QString("Cannot open recording index: %1").arg(m_index.errorString());
+        locker.unlock();
+        emit error(message);
+        return false;
+    }
+    m_fileName = fileName;
+    locker.unlock();
+    emit fileNameChanged();
+    emit startTimeChanged();
+    emit endTimeChanged();
+    return true;
+}
+
+bool DataRecorder::process(RingSample &sample)
+{
+    addSample(sample.timestamp, sample.accel);
+    return true;
+}
+
+void DataRecorder::addSample(qint64 timestamp, QVector3D accelVector)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_recording)
+        return;
+
+    // The index starts at the first sample, on the clock its timestamps come
+    // from, not at whatever the wall clock said when recording was switched on.
+    const bool first = !m_index.isOpen();
+    if (first) {
+        if (!m_index.create(m_fileName, timestamp)) {
+            failRecording(locker, QString("Cannot create recording index: %1").arg(m_index.errorString()));
+            return;
+        }
+        m_lastFlushTime = m_index.startMs();
+    }
+
+    m_stream << QDateTime::fromMSecsSinceEpoch(timestamp).toString(Qt::ISODateWithMs) << ','
+             << accelVector.x() << ',' << accelVector.y() << ',' << accelVector.z() << '\n';
+    m_index.append(timestamp, accelVector);
+
+    // Flush, and tell the GUI thread about the new end, once per interval.
+    // Per 100 ms bucket that would wake it up ten times a second for as long
+    // as the recording runs.
+    const qint64 endTime = m_index.endMs();
+    if (endTime - m_lastFlushTime >= FLUSH_INTERVAL_MS) {
+        m_stream.flush();
+        const bool indexFlushed = m_index.flush();
+        m_lastFlushTime = endTime;
+        if (m_stream.status() != QTextStream::Ok || !indexFlushed) {
+            // Most likely a full disk. Stop here, with what made it to disk
+            // still consistent, rather than record on without an index.
+            const QString message = m_stream.status() != QTextStream::Ok
+                ? QString("Cannot write %1: %2, recording stopped").arg(m_fileName, m_file.errorString())
+                : QString("%1, recording stopped").arg(m_index.errorString());
+            failRecording(locker, message);
+            return;
+        }
+    }
+    else if (!first) {
+        return;
+    }
+
+    locker.unlock();
+    runOnOwnerThread(this, [this, first]() {
+        if (first)
+            emit startTimeChanged();
+        emit endTimeChanged();
+    });
+}
+
+void DataRecorder::failRecording(QMutexLocker<QMutex> &locker, const QString &message)
+{
+    m_recording = false;
+    closeFiles();
+    locker.unlock();
+    runOnOwnerThread(this, [this, message]() {
+        emit recordingChanged();
+        emit error(message);
+    });
+}
+
+bool DataRecorder::startRecording()
+{
+    QMutexLocker locker(&m_mutex);
+    const QDir dataDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    if (!dataDir.mkpath(DATA_FOLDER)) {
+        locker.unlock();
+        emit error(QString("Cannot create %1").arg(dataDir.filePath(DATA_FOLDER)));
+        return false;
+    }
+
+    const QDateTime now = QDateTime::currentDateTime();
+    const QString fileName = dataDir.filePath(
+        QString("%1/ring_data_%2.csv").arg(DATA_FOLDER, now.toString("yyyyMMdd_HHmmss")));
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        const QString message = QString("Cannot open %1: %2").arg(fileName, m_file.errorString());
+        locker.unlock();
+        emit error(message);
+        return false;
+    }
+    // Created with the first sample, see addSample(). Until then there's no
+    // time range, not even the one of the recording browsed before.
+    m_index.close();
+
+    m_stream.setDevice(&m_file);
+    m_stream.resetStatus(); // A failed recording before leaves WriteFailed behind
+    m_stream << "timestamp,accX,accY,accZ\n";
+
+    m_fileName = fileName;
+    m_recording = true;
+    locker.unlock();
+    emit fileNameChanged();
+    emit startTimeChanged();
+    emit endTimeChanged();
+    qInfo() << "Recording to" << m_fileName;
+    return true;
+}
+
+void DataRecorder::stopRecording()
+{
+    QMutexLocker locker(&m_mutex);
+    m_recording = false;
+    if (!m_file.isOpen())
+        return;
+
+    const QString message = closeFiles();
+    const QString fileName = m_fileName;
+    locker.unlock();
+
+    // Signal handlers may call back into the recorder, never emit with m_mutex held.
+    if (!message.isEmpty())
+        emit error(message);
+    emit endTimeChanged();
+    qInfo() << "Recording saved to" << fileName;
+}
+
+QString DataRecorder::closeFiles()
+{
+    QString message;
+    m_stream.flush();
+    if (m_stream.status() != QTextStream::Ok)
+        message = QString("Cannot write %1: %2").arg(m_fileName, m_file.errorString());
+    m_stream.setDevice(nullptr);
+    m_file.close();
+
+    // Finalize the index and reopen it read-only so the recording can still
+    // be browsed with overview(). There is none if no sample ever came in.
+    if (!m_index.isOpen())
+        return message;
+    m_index.close();
+    if (!m_index.open(m_fileName) && message.isEmpty())
+        message = QString("Cannot reopen recording index: %1").arg(m_index.errorString());
+    return message;
+}
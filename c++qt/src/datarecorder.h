@@ -0,0 +1,86 @@
+#ifndef DATARECORDER_H
+#define DATARECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QVariantList>
+#include <QVector3D>
+#include <qqmlintegration.h>
+#include "processinggraph.h"
+#include "recordingindex.h"
+
+// Records accelerometer samples to CSV ("timestamp,accX,accY,accZ") and
+// builds the RecordingIndex for that capture as the samples arrive. Both are
+// flushed every FLUSH_INTERVAL_MS, so a killed app loses only the last few
+// seconds and readers can follow a recording in progress; endTime is notified
+// at the same rate, not per sample. If either fails to
+// write, recording stops with an error() rather than go on with a capture
+// and index that don't match.
+// Samples come from addSample() or, when attached to the processing graph,
+// from process() on a worker thread.
+class DataRecorder : public QObject, public ProcessingStage
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_INTERFACES(ProcessingStage)
+    Q_PROPERTY(bool recording READ recording WRITE setRecording NOTIFY recordingChanged FINAL)
+    Q_PROPERTY(QString fileName READ fileName NOTIFY fileNameChanged FINAL)
+    Q_PROPERTY(qint64 startTime READ startTime NOTIFY startTimeChanged FINAL)
+    Q_PROPERTY(qint64 endTime READ endTime NOTIFY endTimeChanged FINAL)
+
+public:
+    static constexpr qint64 FLUSH_INTERVAL_MS = 10000;
+
+    explicit DataRecorder(QObject *parent = nullptr);
+    ~DataRecorder();
+
+    bool recording() const { return m_recording; }
+    void setRecording(bool recording);
+    QString fileName() const { return m_fileName; }
+    qint64 startTime() const;
+    qint64 endTime() const;
+
+    // Summarise [from, to) (ms since epoch) of the current or last recording
+    // into `buckets` entries of {start, end, count, min, max, mean}.
+    Q_INVOKABLE QVariantList overview(qint64 from, qint64 to, int buckets);
+
+    // Recordings with an index, newest first, as {name, path}.
+    Q_INVOKABLE QVariantList recordings() const;
+    // Browse an earlier recording with overview(); not while recording.
+    Q_INVOKABLE bool openRecording(const QString &fileName);
+
+    bool process(RingSample &sample) override;
+
+public slots:
+    void addSample(qint64 timestamp, QVector3D accelVector);
+
+signals:
+    void recordingChanged();
+    void fileNameChanged();
+    void startTimeChanged();
+    void endTimeChanged();
+    void error(const QString &message);
+
+private:
+    bool startRecording();
+    void stopRecording();
+    // With m_mutex held: flush and close the capture, finalize the index and
+    // reopen it read-only. Returns what went wrong, if anything.
+    QString closeFiles();
+    // With m_mutex held: stop after a failure, then unlock and report it.
+    void failRecording(QMutexLocker<QMutex> &locker, const QString &message);
+
+    // Guards the file, stream and index against the graph's worker.
+    mutable QMutex m_mutex;
+    bool m_recording = false;
+    QString m_fileName;
+    QFile m_file;
+    QTextStream m_stream;
+    RecordingIndex m_index;
+    qint64 m_lastFlushTime = 0;
+};
+
+#endif // DATARECORDER_H
@@ -0,0 +1,123 @@
+#include "fft.h"
+#include <QtMath>
+#include <utility>
+
+namespace {
+// One stage's butterflies within one span. The halves never overlap, which
+// the compiler can't tell from the caller's pointers into the same array.
+void butterflies(float *__restrict re0, float *__restrict im0,
+                 float *__restrict re1, float *__restrict im1,
+                 const float *__restrict cosTable, const float *__restrict sinTable, int half)
+{
+    for (int k = 0; k < half; ++k) {
+        const float wr = cosTable[k];
+        const float wi = sinTable[k];
+        const float tr = wr * re1[k] - wi * im1[k];
+        const float ti = wr * im1[k] + wi * re1[k];
+        re1[k] = re0[k] - tr;
+        im1[k] = im0[k] - ti;
+        re0[k] += tr;
+        im0[k] += ti;
+    }
+}
+}
+
+Fft::Fft(int size)
+{
+    if (size > 0)
+        setSize(size);
+}
+
+void Fft::setSize(int size)
+{
+    Q_ASSERT(isPowerOfTwo(size));
+    m_size = size;
+
+    int bits = 0;
+    while ((1 << bits) < size)
+        bits++;
+
+    m_bitReverse.resize(size);
+    for (int i = 0; i < size; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b))
+                reversed |= 1 << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    m_cos.resize(qMax(size - 1, 0));
+    m_sin.resize(qMax(size - 1, 0));
+    for (int half = 1; half < size; half *= 2) {
+        for (int k = 0; k < half; ++k) {
+            const double angle = -M_PI * k / half;
+            m_cos[half - 1 + k] = float(std::cos(angle));
+            m_sin[half - 1 + k] = float(std::sin(angle));
+        }
+    }
+
+    m_realCos.resize(size / 2 + 1);
+    m_realSin.resize(size / 2 + 1);
+    for (int k = 0; k <= size / 2; ++k) {
+        const double angle = -M_PI * k / size;
+        m_realCos[k] = float(std::cos(angle));
+        m_realSin[k] = float(std::sin(angle));
+    }
+}
+
+void Fft::transform(float *re, float *im) const
+{
+    const int n = m_size;
+
+    for (int i = 0; i < n; ++i) {
+        const int j = m_bitReverse[i];
+        if (j > i) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    for (int half = 1; half < n; half *= 2) {
+        const float *cosTable = m_cos.constData() + half - 1;
+        const float *sinTable = m_sin.constData() + half - 1;
+        for (int start = 0; start < n; start += 2 * half)
+            butterflies(re + start, im + start, re + start + half, im + start + half, cosTable, sinTable, half);
+    }
+}
+
+void Fft::transformReal(const float *in, float *re, float *im) const
+{
+    const int n = m_size;
+
+    // Even samples as the real part, odd ones as the imaginary part.
+    for (int i = 0; i < n; ++i) {
+        re[i] = in[2 * i];
+        im[i] = in[2 * i + 1];
+    }
+    transform(re, im);
+
+    // Bin k is E_k + exp(-i pi k / n) O_k, with the spectra of the even and
+    // odd samples E_k = (Z_k + conj Z_{n-k}) / 2 and O_k = -i (Z_k - conj Z_{n-k}) / 2.
+    // Bins k and n - k use the same two Z, so pairs are done in place.
+    re[n] = re[0] - im[0];
+    im[n] = 0;
+    re[0] += im[0];
+    im[0] = 0;
+    for (int k = 1; k <= n / 2; ++k) {
+        const int j = n - k;
+        const float evenRe = 0.5f * (re[k] + re[j]);
+        const float evenIm = 0.5f * (im[k] - im[j]);
+        const float oddRe = 0.5f * (im[k] + im[j]);
+        const float oddIm = 0.5f * (re[j] - re[k]);
+        // exp(-i pi (n - k) / n) is minus the conjugate of exp(-i pi k / n).
+        const float wr = m_realCos[k];
+        const float wi = m_realSin[k];
+        const float tr = wr * oddRe - wi * oddIm;
+        const float ti = wr * oddIm + wi * oddRe;
+        re[k] = evenRe + tr;
+        im[k] = evenIm + ti;
+        re[j] = evenRe - tr;
+        im[j] = ti - evenIm;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <QList>
+
+// In-place radix-2 complex FFT with precomputed twiddles and bit-reversal
+// table. Data is split into separate real and imaginary arrays, and every
+// stage has its own contiguous twiddle table, so the butterfly loops read
+// and write consecutive floats only and vectorize.
+class Fft
+{
+public:
+    explicit Fft(int size = 0);
+
+    // size must be a power of two.
+    void setSize(int size);
+    int size() const { return m_size; }
+
+    void transform(float *re, float *im) const;
+
+    // Spectrum of 2 * size() real samples, computed with one complex
+    // transform of size() points. re and im receive bins 0 to size(),
+    // so each needs size() + 1 floats.
+    void transformReal(const float *in, float *re, float *im) const;
+
+    static bool isPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+private:
+    int m_size = 0;
+    QList<int> m_bitReverse;
+    // Stage by stage: the one of butterfly span 2 * half starts at half - 1.
+    QList<float> m_cos;
+    QList<float> m_sin;
+    // exp(-i pi k / size) for unpacking transformReal().
+    QList<float> m_realCos;
+    QList<float> m_realSin;
+};
+
+#endif // FFT_H
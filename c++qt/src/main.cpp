@@ -16,7 +16,10 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 #include <QQmlApplicationEngine>
+#include "processinggraph.h"
 
 int main(int argc, char *argv[])
 {
@@ -24,6 +27,16 @@ int main(int argc, char *argv[])
 
     app.setQuitOnLastWindowClosed(false);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption pipelineOption("pipeline",
+                                      "Processing graph configuration (JSON) to use instead of the built-in one.",
+                                      "file");
+    parser.addOption(pipelineOption);
+    parser.process(app);
+    if (parser.isSet(pipelineOption))
+        ProcessingGraph::setConfigFile(parser.value(pipelineOption));
+
     QQmlApplicationEngine engine;
     QObject::connect(
         &engine,
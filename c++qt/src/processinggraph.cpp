@@ -0,0 +1,327 @@
+#include "processinggraph.h"
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QHash>
+
+struct ProcessingGraph::Node
+{
+    QString name;
+    bool pooled = false;
+    QList<Node *> outputs;
+
+    // Held while the stage runs, so a stage is never re-entered and can be
+    // swapped out safely.
+    QMutex processMutex;
+    StageFunction stage;
+    ProcessingStage *attached = nullptr;
+
+    // Bounded queue for pooled nodes, a ring of preallocated slots.
+    QMutex queueMutex;
+    QList<RingSample> buffer;
+    bool grow = false;
+    int maxCapacity = 0;
+    int head = 0;
+    int count = 0;
+    bool scheduled = false;
+    // Reused for every drain, so queueing a sample doesn't allocate.
+    std::unique_ptr<QRunnable> drainer;
+
+    std::atomic<quint64> processed { 0 };
+    std::atomic<quint64> dropped { 0 };
+    quint64 lastProcessed = 0;
+    quint64 lastDropped = 0;
+};
+
+namespace {
+const int DEFAULT_QUEUE_CAPACITY = 256;
+const int DEFAULT_WORKERS = 2;
+
+QString &configFileStorage()
+{
+    static QString fileName = ProcessingGraph::defaultConfigFile();
+    return fileName;
+}
+}
+
+ProcessingGraph::ProcessingGraph(QObject *parent)
+    : QObject(parent)
+{
+    m_pool.setMaxThreadCount(DEFAULT_WORKERS);
+    m_statsTimer.start();
+}
+
+ProcessingGraph::~ProcessingGraph()
+{
+    shutdown();
+}
+
+QString ProcessingGraph::defaultConfigFile()
+{
+    return QStringLiteral(":/qt/qml/R02DataExplorer/pipeline.json");
+}
+
+QString ProcessingGraph::configFile()
+{
+    return configFileStorage();
+}
+
+void ProcessingGraph::setConfigFile(const QString &fileName)
+{
+    configFileStorage() = fileName;
+}
+
+bool ProcessingGraph::loadConfig(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = QString("Cannot open %1: %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (doc.isNull()) {
+        m_errorString = QString("%1: %2").arg(fileName, parseError.errorString());
+        return false;
+    }
+
+    const QJsonObject config = doc.object();
+    std::vector<std::unique_ptr<Node>> nodes;
+    QList<Node *> sources;
+    QHash<QString, Node *> byName;
+
+    for (const QJsonValue &value : config["nodes"].toArray()) {
+        const QJsonObject nodeConfig = value.toObject();
+        auto node = std::make_unique<Node>();
+        node->name = nodeConfig["name"].toString();
+        if (node->name.isEmpty() || byName.contains(node->name)) {
+            m_errorString = QString("%1: missing or duplicate node name '%2'").arg(fileName, node->name);
+            return false;
+        }
+
+        const QString thread = nodeConfig["thread"].toString("caller");
+        if (thread != "caller" && thread != "pool") {
+            m_errorString = QString("%1: node '%2' has unknown thread '%3'").arg(fileName, node->name, thread);
+            return false;
+        }
+        node->pooled = thread == "pool";
+        if (node->pooled) {
+            const int capacity = qMax(1, nodeConfig["queue"].toInt(DEFAULT_QUEUE_CAPACITY));
+            node->buffer.resize(capacity);
+            const QString overflow = nodeConfig["overflow"].toString("drop");
+            if (overflow != "drop" && overflow != "grow") {
+                m_errorString = QString("%1: node '%2' has unknown overflow '%3'").arg(fileName, node->name, overflow);
+                return false;
+            }
+            node->grow = overflow == "grow";
+            node->maxCapacity = node->grow ? capacity * GROW_LIMIT : capacity;
+            Node *target = node.get();
+            node->drainer.reset(QRunnable::create([this, target]() { drain(target); }));
+            node->drainer->setAutoDelete(false);
+        }
+
+        const QJsonArray inputs = nodeConfig["inputs"].toArray();
+        for (const QJsonValue &input : inputs) {
+            Node *upstream = byName.value(input.toString());
+            if (!upstream) {
+                m_errorString = QString("%1: node '%2' input '%3' must be defined before it")
+                                    .arg(fileName, node->name, input.toString());
+                return false;
+            }
+            upstream->outputs.append(node.get());
+        }
+        if (inputs.isEmpty())
+            sources.append(node.get());
+
+        byName.insert(node->name, node.get());
+        nodes.push_back(std::move(node));
+    }
+
+    if (nodes.empty()) {
+        m_errorString = QString("%1: no nodes configured").arg(fileName);
+        return false;
+    }
+
+    shutdown();
+    m_pool.setMaxThreadCount(qMax(1, config["workers"].toInt(DEFAULT_WORKERS)));
+    m_nodes = std::move(nodes);
+    m_sources = sources;
+    qInfo() << "Processing graph loaded from" << fileName << "with" << m_nodes.size() << "nodes";
+    return true;
+}
+
+bool ProcessingGraph::hasNode(const QString &name) const
+{
+    for (const auto &node : m_nodes) {
+        if (node->name == name)
+            return true;
+    }
+    return false;
+}
+
+bool ProcessingGraph::setStage(const QString &name, StageFunction stage)
+{
+    for (const auto &node : m_nodes) {
+        if (node->name == name) {
+            QMutexLocker locker(&node->processMutex);
+            node->stage = std::move(stage);
+            if (node->attached) {
+                node->attached->m_detach = nullptr;
+                node->attached = nullptr;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ProcessingGraph::setStage(const QString &name, ProcessingStage *stage)
+{
+    if (!stage)
+        return setStage(name, StageFunction());
+    if (!setStage(name, [stage](RingSample &sample) { return stage->process(sample); }))
+        return false;
+
+    for (const auto &node : m_nodes) {
+        if (node->name == name) {
+            node->attached = stage;
+            stage->m_detach = [this, name]() { setStage(name, StageFunction()); };
+        }
+    }
+    return true;
+}
+
+void ProcessingGraph::push(const RingSample &sample)
+{
+    for (Node *node : std::as_const(m_sources))
+        deliver(node, sample);
+}
+
+void ProcessingGraph::shutdown()
+{
+    // Drop whatever is still queued, then let running workers finish.
+    for (const auto &node : m_nodes) {
+        QMutexLocker locker(&node->queueMutex);
+        node->count = 0;
+    }
+    m_pool.waitForDone();
+
+    for (const auto &node : m_nodes) {
+        QMutexLocker locker(&node->processMutex);
+        node->stage = StageFunction();
+        if (node->attached) {
+            node->attached->m_detach = nullptr;
+            node->attached = nullptr;
+        }
+    }
+}
+
+void ProcessingGraph::waitForIdle()
+{
+    m_pool.waitForDone();
+}
+
+QVariantList ProcessingGraph::stats()
+{
+    const double seconds = m_statsTimer.restart() / 1000.0;
+
+    QVariantList result;
+    for (const auto &node : m_nodes) {
+        int depth = 0;
+        if (node->pooled) {
+            QMutexLocker locker(&node->queueMutex);
+            depth = node->count;
+        }
+        const quint64 processed = node->processed;
+        const double throughput = seconds > 0 ? (processed - node->lastProcessed) / seconds : 0;
+        node->lastProcessed = processed;
+        const quint64 dropped = node->dropped;
+        const quint64 newlyDropped = dropped - node->lastDropped;
+        node->lastDropped = dropped;
+
+        QVariantMap entry;
+        entry["name"] = node->name;
+        entry["thread"] = node->pooled ? "pool" : "caller";
+        entry["overflow"] = node->grow ? "grow" : "drop";
+        entry["queueDepth"] = depth;
+        entry["queueCapacity"] = int(node->buffer.size());
+        entry["processed"] = processed;
+        entry["dropped"] = dropped;
+        entry["newlyDropped"] = newlyDropped;
+        entry["throughput"] = throughput;
+        result.append(entry);
+    }
+    return result;
+}
+
+void ProcessingGraph::deliver(Node *node, const RingSample &sample)
+{
+    if (!node->pooled) {
+        RingSample copy = sample;
+        run(node, copy);
+        return;
+    }
+
+    QMutexLocker locker(&node->queueMutex);
+    if (node->count == node->buffer.size() && node->buffer.size() < node->maxCapacity) {
+        // Lossless node: make room instead, unrolling the ring as we go.
+        QList<RingSample> grown(qMin(node->buffer.size() * 2, qsizetype(node->maxCapacity)));
+        for (int i = 0; i < node->count; ++i)
+            std::swap(grown[i], node->buffer[(node->head + i) % node->buffer.size()]);
+        node->buffer.swap(grown);
+        node->head = 0;
+        qWarning() << "Processing graph: queue of" << node->name << "grown to" << node->buffer.size();
+    }
+    const int capacity = node->buffer.size();
+    if (node->count == capacity) {
+        // Full: drop the oldest, the newest sample is the one worth having.
+        node->head = (node->head + 1) % capacity;
+        node->count--;
+        node->dropped++;
+    }
+    node->buffer[(node->head + node->count) % capacity] = sample;
+    node->count++;
+
+    if (!node->scheduled) {
+        node->scheduled = true;
+        m_pool.start(node->drainer.get());
+    }
+}
+
+void ProcessingGraph::run(Node *node, RingSample &sample)
+{
+    bool forward = true;
+    {
+        QMutexLocker locker(&node->processMutex);
+        if (node->stage)
+            forward = node->stage(sample);
+    }
+    node->processed++;
+
+    if (forward) {
+        for (Node *output : std::as_const(node->outputs))
+            deliver(output, sample);
+    }
+}
+
+void ProcessingGraph::drain(Node *node)
+{
+    RingSample sample;
+    forever {
+        {
+            QMutexLocker locker(&node->queueMutex);
+            if (node->count == 0) {
+                node->scheduled = false;
+                return;
+            }
+            std::swap(sample, node->buffer[node->head]);
+            node->head = (node->head + 1) % node->buffer.size();
+            node->count--;
+        }
+        run(node, sample);
+    }
+}
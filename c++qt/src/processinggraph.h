@@ -0,0 +1,146 @@
+#ifndef PROCESSINGGRAPH_H
+#define PROCESSINGGRAPH_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMetaObject>
+#include <QMutex>
+#include <QString>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVariantList>
+#include <QVector3D>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// What flows between the nodes of a ProcessingGraph: the raw notification
+// and whatever the stages upstream have decoded from it so far.
+struct RingSample
+{
+    QByteArray packet;
+    double arrivalMs = 0;   // Host arrival time, ms on the monotonic host clock
+    qint64 timestamp = 0;   // Reconstructed sample time, ms since epoch
+    QVector3D rawAccel;
+    QVector3D accel;        // Tared
+};
+
+// A processing step that can be attached to a node of the graph, e.g. from
+// QML with RingConnector::attachStage(). process() is never called
+// concurrently for one node, but may be called from a worker thread.
+class ProcessingStage
+{
+public:
+    virtual ~ProcessingStage() = default;
+    // Return false to stop the sample from flowing downstream.
+    virtual bool process(RingSample &sample) = 0;
+
+protected:
+    // Implementations call this first thing in their destructor; it waits
+    // for a running process() and unbinds the stage from the graph.
+    void detachStage()
+    {
+        if (m_detach) {
+            auto detach = std::move(m_detach);
+            m_detach = nullptr;
+            detach();
+        }
+    }
+
+private:
+    friend class ProcessingGraph;
+    std::function<void()> m_detach;
+};
+
+#define ProcessingStage_iid "io.github.keithel.R02DataExplorer.ProcessingStage"
+Q_DECLARE_INTERFACE(ProcessingStage, ProcessingStage_iid)
+
+// Run f on the thread `object` lives in; directly if we're already there.
+// Stages running on a worker use this to notify QML.
+template <typename Functor>
+void runOnOwnerThread(QObject *object, Functor &&f)
+{
+    if (QThread::currentThread() == object->thread())
+        f();
+    else
+        QMetaObject::invokeMethod(object, std::forward<Functor>(f), Qt::QueuedConnection);
+}
+
+// Small dataflow graph for the packet processing path.
+//
+// Nodes and their connections are read from a JSON file:
+//
+//   { "workers": 2,
+//     "nodes": [ { "name": "decode" },
+//                { "name": "spectrum", "inputs": ["decode"], "thread": "pool", "queue": 256 },
+//                { "name": "recorder", "inputs": ["decode"], "thread": "pool", "queue": 1024,
+//                  "overflow": "grow" } ] }
+//
+// A node with "thread": "caller" runs inline on whatever thread hands it a
+// sample. A "pool" node has a bounded queue drained by the graph's worker
+// pool, one sample at a time. With "overflow": "drop" (the default) the
+// oldest sample is dropped when the queue is full, so a slow stage never
+// holds up the ones upstream of it. Sinks that must not lose samples use
+// "grow": the queue doubles instead, up to GROW_LIMIT times its configured
+// size, and only drops beyond that. Inputs
+// must name nodes defined earlier in the file, nodes without inputs receive
+// everything pushed into the graph.
+//
+// The processing for a node is bound by name with setStage(); a node without
+// a stage passes samples through unchanged.
+class ProcessingGraph : public QObject
+{
+    Q_OBJECT
+
+public:
+    using StageFunction = std::function<bool(RingSample &)>;
+
+    explicit ProcessingGraph(QObject *parent = nullptr);
+    ~ProcessingGraph();
+
+    // Config file used by loadConfig() without arguments; set from the
+    // command line before any graph is created.
+    static QString defaultConfigFile();
+    static QString configFile();
+    static void setConfigFile(const QString &fileName);
+
+    bool loadConfig(const QString &fileName = configFile());
+    QString errorString() const { return m_errorString; }
+
+    bool hasNode(const QString &name) const;
+    bool setStage(const QString &name, StageFunction stage);
+    bool setStage(const QString &name, ProcessingStage *stage);
+
+    void push(const RingSample &sample);
+
+    // Stops the workers and unbinds all stages.
+    void shutdown();
+    // Blocks until every queued sample has been processed.
+    void waitForIdle();
+
+    // Per node: name, thread, overflow, queueDepth, queueCapacity, processed,
+    // dropped, and since the previous call: newlyDropped and throughput
+    // (samples/s).
+    QVariantList stats();
+
+private:
+    struct Node;
+
+    static constexpr int GROW_LIMIT = 64;
+
+    void deliver(Node *node, const RingSample &sample);
+    void run(Node *node, RingSample &sample);
+    void drain(Node *node);
+
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    QList<Node *> m_sources;
+    QThreadPool m_pool;
+    QElapsedTimer m_statsTimer;
+    QString m_errorString;
+};
+
+#endif // PROCESSINGGRAPH_H
@@ -0,0 +1,415 @@
+#include "recordingindex.h"
+#include <QDebug>
+#include <QDir>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+// Every level file starts with this header, followed by packed Buckets.
+// All fields are little-endian.
+struct FileHeader {
+    char magic[8];
+    qint64 startMs;
+    qint64 bucketMs;
+    qint64 reserved;
+};
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout is part of the file format");
+
+const char INDEX_MAGIC[8] = { 'R', '0', '2', 'I', 'D', 'X', '0', '1' };
+
+QString levelFileName(int level)
+{
+    return QString("L%1.bin").arg(level);
+}
+}
+
+RecordingIndex::RecordingIndex()
+{
+    qint64 bucketMs = BASE_BUCKET_MS;
+    for (auto &level : m_levels) {
+        level = std::make_unique<Level>();
+        level->bucketMs = bucketMs;
+        resetBucket(level->pending);
+        bucketMs *= FANOUT;
+    }
+}
+
+RecordingIndex::~RecordingIndex()
+{
+    close();
+}
+
+QString RecordingIndex::indexDirFor(const QString &capturePath)
+{
+    return capturePath + ".idx";
+}
+
+bool RecordingIndex::create(const QString &capturePath, qint64 startMs)
+{
+    close();
+
+    // Align to the base bucket so that index files of different recordings line up.
+    m_startMs = startMs - (startMs % BASE_BUCKET_MS);
+
+    if (!QDir().mkpath(indexDirFor(capturePath))) {
+        m_errorString = QString("Cannot create index directory %1").arg(indexDirFor(capturePath));
+        return false;
+    }
+    if (!openLevelFiles(capturePath, QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+
+    for (auto &level : m_levels) {
+        FileHeader header;
+        std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+        header.startMs = m_startMs;
+        header.bucketMs = level->bucketMs;
+        header.reserved = 0;
+        if (level->file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) {
+            m_errorString = QString("Cannot write %1: %2").arg(level->file.fileName(), level->file.errorString());
+            close();
+            return false;
+        }
+        level->written = 0;
+        resetBucket(level->pending);
+        level->pendingUsed = false;
+    }
+
+    m_open = true;
+    m_writable = true;
+    m_writeFailed = false;
+    return true;
+}
+
+bool RecordingIndex::open(const QString &capturePath)
+{
+    close();
+
+    if (!openLevelFiles(capturePath, QIODevice::ReadOnly))
+        return false;
+
+    for (auto &level : m_levels) {
+        FileHeader header;
+        if (level->file.read(reinterpret_cast<char *>(&header), sizeof(header)) != sizeof(header)
+            || std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0
+            || header.bucketMs != level->bucketMs) {
+            m_errorString = QString("Invalid index file %1").arg(level->file.fileName());
+            close();
+            return false;
+        }
+        m_startMs = header.startMs;
+        level->written = (level->file.size() - qint64(sizeof(FileHeader))) / qint64(sizeof(Bucket));
+        resetBucket(level->pending);
+        level->pendingUsed = false;
+    }
+
+    m_open = true;
+    m_writable = false;
+
+    for (int i = 1; i < LEVELS; ++i) {
+        if (!repairLevel(i))
+            qWarning() << "Cannot repair recording index level" << i << m_errorString;
+    }
+    return true;
+}
+
+bool RecordingIndex::repairLevel(int levelIndex)
+{
+    // The last bucket of a level may be a partial one from a flush(), and
+    // the level below may have moved on since then. Recompute that bucket and
+    // any missing after it from the level below.
+    Level &level = *m_levels[levelIndex];
+    const qint64 lowerWritten = m_levels[levelIndex - 1]->written;
+    const qint64 expected = (lowerWritten + FANOUT - 1) / FANOUT;
+    const qint64 first = qMax<qint64>(0, qMin(level.written, expected) - 1);
+    if (first >= expected)
+        return true;
+
+    QList<Bucket> lower;
+    if (!readBuckets(levelIndex - 1, first * FANOUT, lowerWritten - first * FANOUT, lower))
+        return false;
+    QList<Bucket> rebuilt(expected - first);
+    for (Bucket &bucket : rebuilt)
+        resetBucket(bucket);
+    for (qint64 i = 0; i < lower.size(); ++i)
+        mergeBucket(rebuilt[i / FANOUT], lower.at(i));
+
+    QList<Bucket> current;
+    const qint64 existing = qMax<qint64>(0, level.written - first);
+    if (existing > 0 && !readBuckets(levelIndex, first, existing, current))
+        return false;
+    if (existing == rebuilt.size()
+        && std::memcmp(current.constData(), rebuilt.constData(), existing * sizeof(Bucket)) == 0)
+        return true;
+
+    // Reader mode opens the files read-only, reopen this one to fix it.
+    level.file.close();
+    if (!level.file.open(QIODevice::ReadWrite)) {
+        m_errorString = level.file.errorString();
+        level.file.open(QIODevice::ReadOnly);
+        return false;
+    }
+    m_writeFailed = false;
+    for (qint64 i = 0; i < rebuilt.size(); ++i)
+        writeBucket(levelIndex, first + i, rebuilt.at(i));
+    if (!m_writeFailed)
+        level.written = expected;
+    level.file.resize(qint64(sizeof(FileHeader)) + level.written * qint64(sizeof(Bucket)));
+    level.file.close();
+    if (!level.file.open(QIODevice::ReadOnly)) {
+        m_errorString = level.file.errorString();
+        return false;
+    }
+    if (m_writeFailed)
+        return false;
+    qInfo() << "Rebuilt" << rebuilt.size() << "buckets of" << level.file.fileName();
+    return true;
+}
+
+void RecordingIndex::close()
+{
+    if (m_open && m_writable) {
+        // Finalize the partial bucket of every level, bottom up, so the
+        // coarse levels include the tail of the recording.
+        for (int i = 0; i < LEVELS; ++i) {
+            Level &level = *m_levels[i];
+            if (level.pendingUsed) {
+                writeBucket(i, level.written, level.pending);
+                if (i + 1 < LEVELS)
+                    addToLevel(i + 1, level.written / FANOUT, level.pending);
+                level.written++;
+                resetBucket(level.pending);
+                level.pendingUsed = false;
+            }
+            // Drop anything a flush() wrote past the final end.
+            level.file.resize(qint64(sizeof(FileHeader)) + level.written * qint64(sizeof(Bucket)));
+        }
+    }
+
+    for (auto &level : m_levels) {
+        if (level->file.isOpen())
+            level->file.close();
+    }
+    m_open = false;
+    m_writable = false;
+}
+
+qint64 RecordingIndex::endMs() const
+{
+    const Level &base = *m_levels[0];
+    return m_startMs + (base.written + (base.pendingUsed ? 1 : 0)) * base.bucketMs;
+}
+
+void RecordingIndex::append(qint64 timestampMs, const QVector3D &accel)
+{
+    if (!m_open || !m_writable)
+        return;
+
+    Bucket sample;
+    for (int c = 0; c < 3; ++c) {
+        sample.min[c] = sample.max[c] = sample.sum[c] = accel[c];
+    }
+    sample.count = 1;
+
+    addToLevel(0, qMax<qint64>(0, timestampMs - m_startMs) / BASE_BUCKET_MS, sample);
+}
+
+bool RecordingIndex::flush()
+{
+    if (!m_open || !m_writable)
+        return false;
+
+    // Write the buckets still being filled at their final position, merged
+    // with the partial buckets of the levels below, as readBuckets() does.
+    QList<Bucket> tail;
+    for (int i = 0; i < LEVELS; ++i) {
+        Level &level = *m_levels[i];
+        const qint64 end = tailEnd(i);
+        if (end > level.written && readBuckets(i, level.written, end - level.written, tail)) {
+            for (qint64 j = 0; j < tail.size(); ++j)
+                writeBucket(i, level.written + j, tail.at(j));
+        }
+        if (!level.file.flush() && !m_writeFailed) {
+            m_errorString = QString("Cannot write %1: %2").arg(level.file.fileName(), level.file.errorString());
+            m_writeFailed = true;
+        }
+    }
+    return !m_writeFailed;
+}
+
+qint64 RecordingIndex::tailEnd(int levelIndex) const
+{
+    // One past the last bucket of this level with samples, counting those
+    // that are still in the partial buckets of this level or below.
+    qint64 end = m_levels[levelIndex]->written;
+    qint64 scale = 1;
+    for (int l = levelIndex; l >= 0; --l, scale *= FANOUT) {
+        const Level &lower = *m_levels[l];
+        if (lower.pendingUsed)
+            end = qMax(end, lower.written / scale + 1);
+    }
+    return end;
+}
+
+QList<RecordingIndex::Summary> RecordingIndex::query(qint64 fromMs, qint64 toMs, int buckets)
+{
+    QList<Summary> result;
+    if (!m_open || buckets <= 0 || toMs <= fromMs)
+        return result;
+
+    const double pixelMs = double(toMs - fromMs) / buckets;
+
+    // Coarsest level that still resolves a single output bucket.
+    int levelIndex = 0;
+    while (levelIndex + 1 < LEVELS && m_levels[levelIndex + 1]->bucketMs <= pixelMs)
+        levelIndex++;
+    const Level &level = *m_levels[levelIndex];
+
+    result.resize(buckets);
+    for (int i = 0; i < buckets; ++i) {
+        result[i].startMs = fromMs + qint64(i * pixelMs);
+        result[i].endMs = fromMs + qint64((i + 1) * pixelMs);
+    }
+
+    const qint64 available = tailEnd(levelIndex); // Include the partial buckets
+    const qint64 first = qMax<qint64>(0, (fromMs - m_startMs) / level.bucketMs);
+    const qint64 last = qMin<qint64>(available, (toMs - m_startMs + level.bucketMs - 1) / level.bucketMs);
+    if (first >= last)
+        return result;
+
+    QList<Bucket> levelBuckets;
+    if (!readBuckets(levelIndex, first, last - first, levelBuckets))
+        return result;
+
+    QList<Bucket> merged(buckets);
+    for (Bucket &bucket : merged)
+        resetBucket(bucket);
+
+    for (qint64 i = 0; i < levelBuckets.size(); ++i) {
+        const Bucket &bucket = levelBuckets.at(i);
+        if (bucket.count == 0)
+            continue;
+        const qint64 bucketStart = m_startMs + (first + i) * level.bucketMs;
+        const int out = qBound<qint64>(0, qint64((bucketStart - fromMs) / pixelMs), buckets - 1);
+        mergeBucket(merged[out], bucket);
+    }
+
+    for (int i = 0; i < buckets; ++i) {
+        const Bucket &bucket = merged.at(i);
+        Summary &summary = result[i];
+        summary.count = bucket.count;
+        if (bucket.count == 0)
+            continue;
+        summary.min = QVector3D(bucket.min[0], bucket.min[1], bucket.min[2]);
+        summary.max = QVector3D(bucket.max[0], bucket.max[1], bucket.max[2]);
+        summary.mean = QVector3D(bucket.sum[0], bucket.sum[1], bucket.sum[2]) / float(bucket.count);
+    }
+    return result;
+}
+
+void RecordingIndex::resetBucket(Bucket &bucket)
+{
+    for (int c = 0; c < 3; ++c) {
+        bucket.min[c] = std::numeric_limits<float>::max();
+        bucket.max[c] = std::numeric_limits<float>::lowest();
+        bucket.sum[c] = 0;
+    }
+    bucket.count = 0;
+}
+
+void RecordingIndex::mergeBucket(Bucket &into, const Bucket &from)
+{
+    if (from.count == 0)
+        return;
+    for (int c = 0; c < 3; ++c) {
+        into.min[c] = qMin(into.min[c], from.min[c]);
+        into.max[c] = qMax(into.max[c], from.max[c]);
+        into.sum[c] += from.sum[c];
+    }
+    into.count += from.count;
+}
+
+void RecordingIndex::addToLevel(int levelIndex, qint64 bucketIndex, const Bucket &bucket)
+{
+    Level &level = *m_levels[levelIndex];
+
+    // Close out every bucket before this one; gaps are written as empty buckets.
+    while (bucketIndex > level.written) {
+        writeBucket(levelIndex, level.written, level.pending);
+        if (levelIndex + 1 < LEVELS)
+            addToLevel(levelIndex + 1, level.written / FANOUT, level.pending);
+        level.written++;
+        resetBucket(level.pending);
+    }
+
+    mergeBucket(level.pending, bucket);
+    level.pendingUsed = true;
+}
+
+void RecordingIndex::writeBucket(int levelIndex, qint64 bucketIndex, const Bucket &bucket)
+{
+    QFile &file = m_levels[levelIndex]->file;
+    // Normally an append; flush() leaves the position past the partial buckets.
+    const qint64 offset = qint64(sizeof(FileHeader)) + bucketIndex * qint64(sizeof(Bucket));
+    if ((file.pos() != offset && !file.seek(offset))
+        || file.write(reinterpret_cast<const char *>(&bucket), sizeof(Bucket)) != sizeof(Bucket)) {
+        // Keep the first error, that's the one that explains the rest.
+        if (!m_writeFailed)
+            m_errorString = QString("Cannot write %1: %2").arg(file.fileName(), file.errorString());
+        m_writeFailed = true;
+    }
+}
+
+bool RecordingIndex::readBuckets(int levelIndex, qint64 first, qint64 count, QList<Bucket> &out)
+{
+    Level &level = *m_levels[levelIndex];
+    out.resize(count);
+
+    const qint64 onDisk = qBound<qint64>(0, level.written - first, count);
+    if (onDisk > 0) {
+        if (m_writable)
+            level.file.flush();
+        const qint64 offset = qint64(sizeof(FileHeader)) + first * qint64(sizeof(Bucket));
+        const qint64 bytes = onDisk * qint64(sizeof(Bucket));
+        // writeBucket() seeks back to where it needs to write.
+        if (!level.file.seek(offset)
+            || level.file.read(reinterpret_cast<char *>(out.data()), bytes) != bytes) {
+            m_errorString = level.file.errorString();
+            return false;
+        }
+    }
+
+    // Buckets not on disk yet are assembled from the partial bucket of this
+    // level and of every level below it.
+    for (qint64 i = onDisk; i < count; ++i) {
+        Bucket &bucket = out[i];
+        resetBucket(bucket);
+        if (!m_writable)
+            continue;
+        qint64 scale = 1;
+        for (int l = levelIndex; l >= 0; --l, scale *= FANOUT) {
+            const Level &lower = *m_levels[l];
+            if (lower.pendingUsed && lower.written / scale == first + i)
+                mergeBucket(bucket, lower.pending);
+        }
+    }
+    return true;
+}
+
+bool RecordingIndex::openLevelFiles(const QString &capturePath, QIODevice::OpenMode mode)
+{
+    const QDir dir(indexDirFor(capturePath));
+    for (int i = 0; i < LEVELS; ++i) {
+        QFile &file = m_levels[i]->file;
+        file.setFileName(dir.filePath(levelFileName(i)));
+        if (!file.open(mode)) {
+            m_errorString = QString("Cannot open %1: %2").arg(file.fileName(), file.errorString());
+            for (auto &level : m_levels) {
+                if (level->file.isOpen())
+                    level->file.close();
+            }
+            return false;
+        }
+    }
+    return true;
+}
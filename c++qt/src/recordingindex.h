@@ -0,0 +1,106 @@
+#ifndef RECORDINGINDEX_H
+#define RECORDINGINDEX_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVector3D>
+#include <array>
+#include <memory>
+
+// Min/max/mean pyramid over the accelerometer samples of one recording.
+//
+// Level 0 buckets cover BASE_BUCKET_MS each, every level above aggregates
+// FANOUT buckets of the level below. Each level is its own flat file of
+// fixed-size buckets inside "<capture>.idx/", so bucket k of a level lives at
+// a known offset and a query only ever reads the handful of buckets it needs.
+// Gaps in the recording are stored as empty (count == 0) buckets.
+//
+// The writer keeps just the partially filled bucket of each level in memory,
+// so building the index while recording costs O(LEVELS) memory regardless of
+// how long the session runs. flush() writes those partial buckets out too, in
+// place, so readers of a recording in progress (or one whose writer was
+// killed) see it up to the last flush; they are overwritten once complete.
+class RecordingIndex
+{
+public:
+    static constexpr qint64 BASE_BUCKET_MS = 100;
+    static constexpr int FANOUT = 8;
+    static constexpr int LEVELS = 8; // Level 7 buckets span ~58 hours
+
+    // On-disk bucket layout, shared with python/ring_index.py.
+    struct Bucket {
+        float min[3];
+        float max[3];
+        float sum[3];
+        quint32 count;
+    };
+    static_assert(sizeof(Bucket) == 40, "Bucket layout is part of the file format");
+
+    // One entry of a query result, merged to the requested resolution.
+    struct Summary {
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        quint32 count = 0;
+        QVector3D min;
+        QVector3D max;
+        QVector3D mean;
+    };
+
+    RecordingIndex();
+    ~RecordingIndex();
+
+    static QString indexDirFor(const QString &capturePath);
+
+    // Start a new index for the capture at capturePath (writer mode).
+    bool create(const QString &capturePath, qint64 startMs);
+    // Open an existing index for querying (reader mode). Coarse levels that
+    // lag behind the level below them, because the writer didn't get to
+    // close() or flush(), are rebuilt from it.
+    bool open(const QString &capturePath);
+    void close();
+
+    bool isOpen() const { return m_open; }
+    bool isWritable() const { return m_writable; }
+    QString errorString() const { return m_errorString; }
+    qint64 startMs() const { return m_startMs; }
+    qint64 endMs() const;
+
+    // Samples must be appended in non-decreasing timestamp order.
+    void append(qint64 timestampMs, const QVector3D &accel);
+    // Write out completed and partially filled buckets so readers see them.
+    // False if this or any earlier write since create() failed (e.g. a full
+    // disk), the index then no longer matches the capture; see errorString().
+    bool flush();
+
+    // Summarise [fromMs, toMs) into at most `buckets` equal-width entries.
+    // Reads O(buckets * FANOUT) index buckets whatever the recording length.
+    QList<Summary> query(qint64 fromMs, qint64 toMs, int buckets);
+
+private:
+    struct Level {
+        QFile file;
+        qint64 bucketMs = 0;
+        qint64 written = 0;      // Buckets already on disk
+        Bucket pending;          // Bucket `written`, still being filled
+        bool pendingUsed = false;
+    };
+
+    static void resetBucket(Bucket &bucket);
+    static void mergeBucket(Bucket &into, const Bucket &from);
+    void addToLevel(int level, qint64 bucketIndex, const Bucket &bucket);
+    void writeBucket(int level, qint64 bucketIndex, const Bucket &bucket);
+    qint64 tailEnd(int level) const;
+    bool repairLevel(int level);
+    bool readBuckets(int level, qint64 first, qint64 count, QList<Bucket> &out);
+    bool openLevelFiles(const QString &capturePath, QIODevice::OpenMode mode);
+
+    std::array<std::unique_ptr<Level>, LEVELS> m_levels;
+    qint64 m_startMs = 0;
+    bool m_open = false;
+    bool m_writable = false;
+    bool m_writeFailed = false;
+    QString m_errorString;
+};
+
+#endif // RECORDINGINDEX_H
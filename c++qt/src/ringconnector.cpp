@@ -2,9 +2,12 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDataStream>
+#include <QDateTime>
 #include <QGuiApplication>
+#include <QMutexLocker>
 #include <QScreen>
 #include <QThread>
+#include <cmath>
 
 RingConnector::RingConnector(QObject *parent)
     : QObject(parent),
@@ -12,7 +15,8 @@ RingConnector::RingConnector(QObject *parent)
     m_controller(nullptr),
     m_uartService(nullptr),
     m_batteryRequestTimer(new QTimer(this)),
-    m_packetRateTimer(new QTimer(this))
+    m_packetRateTimer(new QTimer(this)),
+    m_reconnectTimer(new QTimer(this))
 {
     connect(m_discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered,
             this, &RingConnector::deviceDiscovered);
@@ -25,16 +29,30 @@ RingConnector::RingConnector(QObject *parent)
                 }
             });
 
-    m_batteryRequestTimer->setInterval(30000);
-    m_batteryRequestTimer->setSingleShot(false);
-    connect(m_batteryRequestTimer, &QTimer::timeout, this, &RingConnector::getBatteryLevel);
+    m_hostClock.start();
+    m_hostClockEpochMs = QDateTime::currentMSecsSinceEpoch();
+    m_clockModel.setNominalPeriodMs(NOMINAL_SAMPLE_PERIOD_MS);
 
+    // None of these timers run while disconnected, see startStreamTimers() and enterIdle().
+    m_batteryRequestTimer->setSingleShot(true);
+    m_batteryRequestTimer->setTimerType(Qt::VeryCoarseTimer);
+    connect(m_batteryRequestTimer, &QTimer::timeout, this, &RingConnector::pollBatteryLevel);
+
+    m_packetRateTimer->setInterval(PACKET_RATE_INTERVAL_MS);
+    m_packetRateTimer->setTimerType(Qt::CoarseTimer);
     connect(m_packetRateTimer, &QTimer::timeout, this, &RingConnector::updatePacketRate);
-    m_packetRateTimer->start(5000);
+
+    // Auto-reconnect logic
+    m_reconnectTimer->setSingleShot(true);
+    m_reconnectTimer->setInterval(RECONNECT_DELAY_MS);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &RingConnector::startDeviceDiscovery);
+
+    setupProcessingGraph();
 }
 
 RingConnector::~RingConnector()
 {
+    m_graph.shutdown();
     disableStream();
     stopDeviceDiscovery();
 }
@@ -76,16 +94,38 @@ void RingConnector::stopDeviceDiscovery()
     m_ringDevice = QBluetoothDeviceInfo();
     m_foundRxChar = false;
     m_foundTxChar = false;
+    m_reconnectTimer->stop();
+    enterIdle();
 
     emit statusUpdate("Stopped.");
 }
 
 void RingConnector::calibrate()
 {
+    QMutexLocker locker(&m_accelMutex);
     m_offsetAccel = m_lastRawAccel;
+    const QVector3D offset = m_offsetAccel;
+    locker.unlock();
+
+    // No zero sample is emitted here: accelerometerDataReady is sensor data,
+    // and whatever listens to it would record or analyse a fake reading. The
+    // next packet comes in tared.
     emit statusUpdate("Calibrated: Zero point set.");
-    qInfo() << "Calibrated offsets ->" << m_offsetAccel;
-    emit accelerometerDataReady(QVector3D());
+    qInfo() << "Calibrated offsets ->" << offset;
+}
+
+bool RingConnector::attachStage(const QString &name, QObject *stage)
+{
+    ProcessingStage *processingStage = qobject_cast<ProcessingStage *>(stage);
+    if (!processingStage) {
+        emit error(QString("Cannot attach '%1': not a processing stage.").arg(name));
+        return false;
+    }
+    if (!m_graph.setStage(name, processingStage)) {
+        qInfo() << "No" << name << "node in the processing graph, stage not attached";
+        return false;
+    }
+    return true;
 }
 
 void RingConnector::deviceDiscovered(const QBluetoothDeviceInfo &device)
@@ -143,13 +183,17 @@ void RingConnector::controllerError(QLowEnergyController::Error newError)
 
 void RingConnector::controllerDisconnected()
 {
+    // The stream restarts from scratch on reconnect, don't try to continue the old lock.
+    {
+        QMutexLocker locker(&m_accelMutex);
+        m_clockModel.reset();
+    }
+
+    enterIdle();
+
     if (m_allowAutoreconnect) {
         emit statusUpdate("Controller disconnected, reconnecting.");
-
-        // Auto-reconnect logic
-        QTimer::singleShot(1000, [this](){
-            startDeviceDiscovery();
-        });
+        m_reconnectTimer->start();
     }
     else {
         emit statusUpdate("Controller disconnected.");
@@ -225,18 +269,13 @@ void RingConnector::serviceStateChanged(QLowEnergyService::ServiceState newState
             commandPacket[1] = static_cast<char>(0x04);
 
             // Calculate and append the checksum
-            // left(15) gives us the first 15 bytes (0..14)
-            commandPacket[15] = calculateChecksum(commandPacket.left(15));
+            // first(15) gives us the first 15 bytes (0..14)
+            commandPacket[15] = calculateChecksum(QByteArrayView(commandPacket).first(15));
 
             emit statusUpdate(QString("Writing 'Start Stream' command (0xA104): %1").arg(commandPacket.toHex()));
             writeToRxCharacteristic(commandPacket);
 
-            if (!m_batteryRequestTimer->isActive()) {
-                // Request battery level immediately, and start a timer that will repeatedly request the battery level.
-                // See constructor for interval and connection.
-                getBatteryLevel();
-                m_batteryRequestTimer->start();
-            }
+            startStreamTimers();
         }
     }
 }
@@ -244,8 +283,10 @@ void RingConnector::serviceStateChanged(QLowEnergyService::ServiceState newState
 void RingConnector::characteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &value)
 {
     if (characteristic.uuid() == UART_TX_CHAR_UUID) {
-        // qInfo() << "Raw data received:" << value.toHex();
-        parsePacket(value);
+#ifdef R02_PACKET_TRACE
+        qDebug() << "Raw data received:" << value.toHex();
+#endif
+        parsePacket(value, m_hostClock.nsecsElapsed() / 1e6);
     }
 }
 
@@ -259,20 +300,137 @@ void RingConnector::getBatteryLevel()
     // Command: 0x03 (Battery Request)
     QByteArray commandPacket(16, 0x00);
     commandPacket[0] = static_cast<char>(0x03);
-    commandPacket[15] = calculateChecksum(commandPacket.left(15));
+    commandPacket[15] = calculateChecksum(QByteArrayView(commandPacket).first(15));
 
     // emit statusUpdate("Requesting Battery Level...");
     writeToRxCharacteristic(commandPacket);
 }
 
+void RingConnector::pollBatteryLevel()
+{
+    getBatteryLevel();
+
+    // Re-armed with an adapted interval when the reply arrives; this is the
+    // fallback in case it never does.
+    m_batteryRequestTimer->start(scaledInterval(m_batteryPollIntervalMs));
+}
+
+void RingConnector::adaptBatteryPolling(int previousLevel, int level)
+{
+    // The level moves by a percent every so many minutes. Back off while it
+    // is unchanged, come back to the fast rate when it moves, and keep an eye
+    // on it once it gets low. The reply to the poll made on connecting
+    // says nothing about how fast the level moves, so don't back off yet.
+    if (m_firstBatteryReply || previousLevel != level)
+        m_batteryPollIntervalMs = BATTERY_POLL_MIN_MS;
+    else
+        m_batteryPollIntervalMs = qMin(m_batteryPollIntervalMs * 2, BATTERY_POLL_MAX_MS);
+    m_firstBatteryReply = false;
+    if (level <= LOW_BATTERY_LEVEL)
+        m_batteryPollIntervalMs = qMin(m_batteryPollIntervalMs, BATTERY_POLL_LOW_MS);
+
+    if (m_streaming)
+        m_batteryRequestTimer->start(scaledInterval(m_batteryPollIntervalMs));
+}
+
+void RingConnector::startStreamTimers()
+{
+    if (m_streaming)
+        return;
+    m_streaming = true;
+
+    // Request battery level immediately, then adaptively, see adaptBatteryPolling().
+    m_batteryPollIntervalMs = BATTERY_POLL_MIN_MS;
+    m_firstBatteryReply = true;
+    pollBatteryLevel();
+    m_packetCounter = 0;
+    m_packetRateTimer->start();
+}
+
+void RingConnector::enterIdle()
+{
+    // Nothing to measure or poll without a connection: disarm everything so
+    // the app doesn't wake up at all until the ring is back.
+    m_streaming = false;
+    m_batteryRequestTimer->stop();
+    m_packetRateTimer->stop();
+    m_packetCounter = 0;
+    if (m_packetRate != 0) {
+        m_packetRate = 0;
+        emit packetRateChanged();
+    }
+}
+
+int RingConnector::scaledInterval(int ms) const
+{
+    return qMax(1, qRound(ms / m_timeScale));
+}
+
+void RingConnector::setTimeScale(double scale)
+{
+    // Coarse timers would round the shortened intervals to whole seconds or
+    // several percent, which is no longer what the unscaled app does.
+    m_timeScale = scale;
+    for (QTimer *timer : { m_batteryRequestTimer, m_packetRateTimer, m_reconnectTimer })
+        timer->setTimerType(Qt::PreciseTimer);
+    m_packetRateTimer->setInterval(scaledInterval(PACKET_RATE_INTERVAL_MS));
+    m_reconnectTimer->setInterval(scaledInterval(RECONNECT_DELAY_MS));
+}
+
+int RingConnector::armedTimerCount() const
+{
+    int armed = 0;
+    for (const QTimer *timer : { m_batteryRequestTimer, m_packetRateTimer, m_reconnectTimer }) {
+        if (timer->isActive())
+            armed++;
+    }
+    return armed;
+}
+
 void RingConnector::updatePacketRate()
 {
     if (m_packetRate != m_packetCounter) {
-        m_packetRate = m_packetCounter / (m_packetRateTimer->interval()/1000);
+        m_packetRate = m_packetCounter / (PACKET_RATE_INTERVAL_MS / 1000);
         qDebug().noquote().nospace() << "Packet rate: " << m_packetRate << " Hz";
         emit packetRateChanged();
     }
     m_packetCounter = 0;
+
+    double period = 0;
+    double drift = 0;
+    double jitter = 0;
+    qint64 lost = 0;
+    {
+        QMutexLocker locker(&m_accelMutex);
+        if (m_clockModel.locked()) {
+            period = m_clockModel.periodMs();
+            drift = m_clockModel.driftPpm();
+            jitter = m_clockModel.jitterMs();
+            lost = m_clockModel.lostCount();
+        }
+    }
+    // Publish only changes that matter: QML recomputes everything bound to
+    // samplePeriod, the spectrum's band bins included, on every signal.
+    if (period > 0
+        && (std::abs(period - m_samplePeriod) >= SAMPLE_PERIOD_CHANGE * m_samplePeriod
+            || std::abs(drift - m_clockDrift) >= CLOCK_DRIFT_CHANGE_PPM)) {
+        m_samplePeriod = period;
+        m_clockDrift = drift;
+        qDebug().noquote().nospace() << "Sample period: " << period << " ms, drift " << drift << " ppm, jitter "
+                                     << jitter << " ms, " << lost << " samples lost";
+        emit clockModelChanged();
+    }
+
+    m_stageStats = m_graph.stats();
+    emit stageStatsChanged();
+
+    for (const QVariant &stats : std::as_const(m_stageStats)) {
+        const QVariantMap node = stats.toMap();
+        const quint64 dropped = node["newlyDropped"].toULongLong();
+        if (dropped > 0)
+            emit error(QString("Stage '%1' dropped %2 samples, its queue was full")
+                           .arg(node["name"].toString()).arg(dropped));
+    }
 }
 
 void RingConnector::disableStream()
@@ -283,7 +441,7 @@ void RingConnector::disableStream()
         QByteArray disablePacket(16, 0x00);
         disablePacket[0] = 0xA1;
         disablePacket[1] = 0x02;
-        disablePacket[15] = calculateChecksum(disablePacket.left(15));
+        disablePacket[15] = calculateChecksum(QByteArrayView(disablePacket).first(15));
         writeToRxCharacteristic(disablePacket);
         emit statusUpdate("Sent Disable Stream command.");
 
@@ -302,7 +460,7 @@ void RingConnector::writeToRxCharacteristic(const QByteArray &data)
     m_uartService->writeCharacteristic(m_rxCharacteristic, data, QLowEnergyService::WriteWithoutResponse);
 }
 
-char RingConnector::calculateChecksum(const QByteArray &data)
+char RingConnector::calculateChecksum(QByteArrayView data)
 {
     // Checksum is sum of first 15 bytes, mod 255
     // Python: checksum = sum(bytes_array) & 0xFF
@@ -313,58 +471,17 @@ char RingConnector::calculateChecksum(const QByteArray &data)
     return static_cast<char>(sum);
 }
 
-void RingConnector::parsePacket(const QByteArray &packet)
+void RingConnector::parsePacket(const QByteArray &packet, double arrivalMs)
 {
     if (packet.length() < 3) return;
 
     m_packetCounter++;
 
-    // Packet structure  for ACCEL_PACKET_CMD is [CMD, PAYLOAD(14), CHECKSUM]
-
-    const quint8 ACCEL_PACKET_CMD = 0xA1;
     const quint8 BATT_PACKET_CMD = 0x03;
     const quint8 cmd = static_cast<quint8>(packet[0]);
 
-
-    if (cmd == ACCEL_PACKET_CMD) {
-        if (packet.length() < 10) return;
-
-        const quint8 DESIRED_SUBTYPE = 0x03;
-        const quint8 subtype = static_cast<quint8>(packet[1]);
-        if (subtype != DESIRED_SUBTYPE) return;
-
-        // Helper to extract a 12-bit value from 2 bytes (High, Low)
-        auto parse12Bit = [](quint8 h, quint8 l) -> int {
-            int val = (h << 4) | (l & 0xF);
-            if (h & 0x08) {
-                val -= (1 << 11); // 2048
-            }
-            return val;
-        };
-
-        quint8 accelBytes[6];
-        for(auto i = 0; i < 6; i++)
-            accelBytes[i] = static_cast<quint8>(packet[i+2]);
-
-        QVector3D accelVals;
-        for(auto i = 0; i < 3; i++)
-            accelVals[i] = parse12Bit(accelBytes[i*2], accelBytes[i*2+1]);
-
-        m_lastRawAccel = accelVals;
-
-        // Apply tare offset to the values we send out.
-        accelVals -= m_offsetAccel;
-
-        // Handle Mouse Logic (if enabled)
-        if (m_mouseControlEnabled) {
-            handleMouseMovement(accelVals);
-        }
-
-        emit accelerometerDataReady(accelVals);
-        qDebug() << "Accel Vals:" << accelVals;
-    }
     // --- Battery Data ---
-    else if (cmd == BATT_PACKET_CMD) {
+    if (cmd == BATT_PACKET_CMD) {
         // Based on tahnok/colmi_r02_client battery.py
         // Packet: [0x03, level, voltage_h, voltage_l, ..., checksum]
         if (packet.length() >= 4) {
@@ -378,6 +495,7 @@ void RingConnector::parsePacket(const QByteArray &packet)
             int voltage = (v_h << 8) | v_l;
 
             qInfo() << "[BAT STATUS]" << level << "%" << voltage << "mV";
+            adaptBatteryPolling(m_batteryLevel, level);
             if (m_batteryLevel != level) {
                 m_batteryLevel = level;
                 emit batteryLevelChanged();
@@ -388,7 +506,103 @@ void RingConnector::parsePacket(const QByteArray &packet)
             }
             // emit statusUpdate(QString("Battery: %1% (%2 mV)").arg(level).arg(voltage));
         }
+        return;
+    }
+
+    // Sensor data goes through the processing graph.
+    RingSample sample;
+    sample.packet = packet;
+    sample.arrivalMs = arrivalMs;
+    m_graph.push(sample);
+}
+
+void RingConnector::setupProcessingGraph()
+{
+    if (!m_graph.loadConfig()) {
+        qWarning() << m_graph.errorString();
+        if (ProcessingGraph::configFile() == ProcessingGraph::defaultConfigFile()
+            || !m_graph.loadConfig(ProcessingGraph::defaultConfigFile())) {
+            qWarning() << "No usable processing graph, sensor data will be ignored.";
+            return;
+        }
+        qWarning() << "Using the default processing graph instead.";
     }
+
+    m_graph.setStage("decode", [this](RingSample &sample) {
+        return decodeAccelerometer(sample);
+    });
+
+    // Apply tare offset to the values we send out.
+    m_graph.setStage("tare", [this](RingSample &sample) {
+        QMutexLocker locker(&m_accelMutex);
+        sample.accel = sample.rawAccel - m_offsetAccel;
+        return true;
+    });
+
+    // Handle Mouse Logic (if enabled). The cursor can only be moved from the GUI thread.
+    m_graph.setStage("mouse", [this](RingSample &sample) {
+        if (m_mouseControlEnabled) {
+            runOnOwnerThread(this, [this, accel = sample.accel]() {
+                handleMouseMovement(accel);
+            });
+        }
+        return true;
+    });
+
+    m_graph.setStage("ui", [this](RingSample &sample) {
+        runOnOwnerThread(this, [this, accel = sample.accel, timestamp = sample.timestamp]() {
+            emit accelerometerDataReady(accel, timestamp);
+        });
+#ifdef R02_PACKET_TRACE
+        qDebug() << "Accel Vals:" << sample.accel;
+#endif
+        return true;
+    });
+}
+
+bool RingConnector::decodeAccelerometer(RingSample &sample)
+{
+    // Packet structure  for ACCEL_PACKET_CMD is [CMD, PAYLOAD(14), CHECKSUM]
+    const QByteArray &packet = sample.packet;
+    const quint8 ACCEL_PACKET_CMD = 0xA1;
+    if (packet.length() < 10 || static_cast<quint8>(packet[0]) != ACCEL_PACKET_CMD) return false;
+
+    const quint8 DESIRED_SUBTYPE = 0x03;
+    const quint8 subtype = static_cast<quint8>(packet[1]);
+    if (subtype != DESIRED_SUBTYPE) return false;
+
+    // Helper to extract a 12-bit value from 2 bytes (High, Low)
+    auto parse12Bit = [](quint8 h, quint8 l) -> int {
+        int val = (h << 4) | (l & 0xF);
+        if (h & 0x08) {
+            val -= (1 << 11); // 2048
+        }
+        return val;
+    };
+
+    quint8 accelBytes[6];
+    for(auto i = 0; i < 6; i++)
+        accelBytes[i] = static_cast<quint8>(packet[i+2]);
+
+    QVector3D accelVals;
+    for(auto i = 0; i < 3; i++)
+        accelVals[i] = parse12Bit(accelBytes[i*2], accelBytes[i*2+1]);
+
+    QMutexLocker locker(&m_accelMutex);
+    m_lastRawAccel = accelVals;
+    const double timestamp = m_clockModel.addArrival(sample.arrivalMs);
+    if (m_clockModel.restartCount() != m_clockRestarts) {
+        // The host clock doesn't run while the machine sleeps, so the wall
+        // clock read at startup is off by every suspend since. Re-read it
+        // whenever the model starts over, which it does after any such gap.
+        m_clockRestarts = m_clockModel.restartCount();
+        m_hostClockEpochMs = QDateTime::currentMSecsSinceEpoch() - m_hostClock.elapsed();
+    }
+    m_lastTimestamp = m_hostClockEpochMs + qint64(timestamp);
+
+    sample.rawAccel = accelVals;
+    sample.timestamp = m_lastTimestamp;
+    return true;
 }
 
 void RingConnector::setAllowAutoreconnect(bool newAllowAutoreconnect)
@@ -6,10 +6,15 @@
 #include <QLowEnergyController>
 #include <QLowEnergyService>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QMutex>
 #include <qqmlintegration.h>
 #include <QVector3D>
 #include <QCursor> // Added for mouse control
 #include <QPoint>
+#include <atomic>
+#include "clockmodel.h"
+#include "processinggraph.h"
 
 // UUIDs from ring.py
 const QBluetoothUuid UART_SERVICE_UUID(QStringLiteral("6E40FFF0-B5A3-F393-E0A9-E50E24DCCA9E"));
@@ -27,6 +32,9 @@ class RingConnector : public QObject
     Q_PROPERTY(int batteryLevel READ batteryLevel NOTIFY batteryLevelChanged FINAL)
     Q_PROPERTY(int batteryVoltage READ batteryVoltage NOTIFY batteryVoltageChanged FINAL)
     Q_PROPERTY(int packetRate READ packetRate NOTIFY packetRateChanged FINAL)
+    Q_PROPERTY(double samplePeriod READ samplePeriod NOTIFY clockModelChanged FINAL)
+    Q_PROPERTY(double clockDrift READ clockDrift NOTIFY clockModelChanged FINAL)
+    Q_PROPERTY(QVariantList stageStats READ stageStats NOTIFY stageStatsChanged FINAL)
 
 public:
     explicit RingConnector(QObject *parent = nullptr);
@@ -39,13 +47,21 @@ public:
     int batteryLevel() const { return m_batteryLevel; }
     int batteryVoltage() const { return m_batteryVoltage; }
     int packetRate() const { return m_packetRate; }
+    double samplePeriod() const { return m_samplePeriod; }
+    double clockDrift() const { return m_clockDrift; }
+    QVariantList stageStats() const { return m_stageStats; }
+
+    // Bind a QML object implementing ProcessingStage (e.g. SpectrumAnalyzer,
+    // DataRecorder) to the node of that name in the processing graph.
+    Q_INVOKABLE bool attachStage(const QString &name, QObject *stage);
 
 public slots:
     void startDeviceDiscovery();
     void calibrate();
 
 signals:
-    void accelerometerDataReady(QVector3D accelVector);
+    // timestamp is the reconstructed sample time in ms since epoch, see ClockModel.
+    void accelerometerDataReady(QVector3D accelVector, qint64 timestamp);
     void statusUpdate(const QString &message);
     void error(const QString &message);
 
@@ -54,6 +70,8 @@ signals:
     void batteryLevelChanged();
     void batteryVoltageChanged();
     void packetRateChanged();
+    void clockModelChanged();
+    void stageStatsChanged();
 
 private slots:
     // Device discovery slots
@@ -74,17 +92,30 @@ private slots:
     void characteristicChanged(const QLowEnergyCharacteristic &characteristic, const QByteArray &value);
 
     void getBatteryLevel();
+    void pollBatteryLevel();
     void updatePacketRate();
 
 private:
     void disableStream();
     void stopDeviceDiscovery();
     void writeToRxCharacteristic(const QByteArray &data);
-    char calculateChecksum(const QByteArray &data);
-    void parsePacket(const QByteArray &packet); // Renamed from parseAccelerometerPacket
+    char calculateChecksum(QByteArrayView data);
+    // arrivalMs is on m_hostClock, see m_hostClockEpochMs.
+    void parsePacket(const QByteArray &packet, double arrivalMs); // Renamed from parseAccelerometerPacket
+    void setupProcessingGraph();
+    void startStreamTimers();
+    void enterIdle();
+    void adaptBatteryPolling(int previousLevel, int level);
+    int scaledInterval(int ms) const;
+    // For SoakHarness: run the timers `scale` times faster.
+    void setTimeScale(double scale);
+    int armedTimerCount() const;
+    bool decodeAccelerometer(RingSample &sample);
     void handleMouseMovement(QVector3D accelVector);
 
 private:
+    friend class SoakHarness;
+
     QMetaObject::Connection m_controllerDisconnectedConnection;
 
     QBluetoothDeviceDiscoveryAgent *m_discoveryAgent = nullptr;
@@ -98,21 +129,55 @@ private:
     bool m_foundTxChar = false;
     bool m_allowAutoreconnect = false;
 
+    // Packet processing, see pipeline.json. Stages may run on worker
+    // threads, m_accelMutex guards the state they share with the GUI thread.
+    ProcessingGraph m_graph;
+    QVariantList m_stageStats;
+    mutable QMutex m_accelMutex;
+
     // Storage for calibration
     QVector3D m_lastRawAccel;
     QVector3D m_offsetAccel;
 
-    bool m_mouseControlEnabled = false;
+    std::atomic<bool> m_mouseControlEnabled { false };
 
     // Configuration
     const int DEADZONE = 200;   // Ignore movements smaller than this
     const double SENSITIVITY = 0.015; // Multiplier for cursor speed
 
+    // Battery polling backs off from MIN to MAX while the level is unchanged.
+    const int BATTERY_POLL_MIN_MS = 30000;
+    const int BATTERY_POLL_MAX_MS = 15 * 60000;
+    const int BATTERY_POLL_LOW_MS = 2 * 60000;
+    const int LOW_BATTERY_LEVEL = 20;
+    const int PACKET_RATE_INTERVAL_MS = 5000;
+    const double NOMINAL_SAMPLE_PERIOD_MS = 40.0; // The accelerometer streams at 25 Hz
+    const double SAMPLE_PERIOD_CHANGE = 1e-3;     // Relative, before a new period is published
+    const double CLOCK_DRIFT_CHANGE_PPM = 1.0;
+    const int RECONNECT_DELAY_MS = 1000;
+
+    bool m_streaming = false;
+    double m_timeScale = 1.0;
     QTimer *m_batteryRequestTimer = nullptr;
+    int m_batteryPollIntervalMs = BATTERY_POLL_MIN_MS;
+    bool m_firstBatteryReply = false;
     int m_batteryLevel = -1;
     int m_batteryVoltage = -1;
 
+    // Monotonic host clock for packet arrival times. m_hostClockEpochMs maps
+    // it to ms since epoch, re-read from the wall clock on every restart of
+    // the clock model.
+    QElapsedTimer m_hostClock;
+    qint64 m_hostClockEpochMs = 0;
+    ClockModel m_clockModel;
+    int m_clockRestarts = 0;
+    // What the GUI thread last published of m_clockModel.
+    double m_samplePeriod = 0;
+    double m_clockDrift = 0;
+    qint64 m_lastTimestamp = 0;
+
     QTimer *m_packetRateTimer = nullptr;
+    QTimer *m_reconnectTimer = nullptr;
     int m_packetCounter = 0;
     int m_packetRate = -1;
 };
@@ -0,0 +1,284 @@
+#include "spectrumanalyzer.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtMath>
+#include <utility>
+
+SpectrumAnalyzer::SpectrumAnalyzer(QObject *parent)
+    : QObject(parent)
+{
+    reconfigure();
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    detachStage();
+}
+
+void SpectrumAnalyzer::setWindowSize(int windowSize)
+{
+    if (m_windowSize == windowSize)
+        return;
+    if (windowSize < 8 || !Fft::isPowerOfTwo(windowSize)) {
+        qWarning() << "SpectrumAnalyzer: window size must be a power of two >= 8, got" << windowSize;
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_windowSize = windowSize;
+        m_hopSize = qMin(m_hopSize, m_windowSize);
+        reconfigure();
+    }
+    emit configurationChanged();
+    emit bandPowersChanged();
+}
+
+void SpectrumAnalyzer::setHopSize(int hopSize)
+{
+    if (m_hopSize == hopSize)
+        return;
+    if (hopSize < 1 || hopSize > m_windowSize) {
+        qWarning() << "SpectrumAnalyzer: hop size must be between 1 and the window size, got" << hopSize;
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_hopSize = hopSize;
+    }
+    emit configurationChanged();
+}
+
+void SpectrumAnalyzer::setSampleRate(double sampleRate)
+{
+    if (sampleRate <= 0 || qFuzzyCompare(m_sampleRate, sampleRate))
+        return;
+    // Only the bin to band mapping depends on the rate, keep the history.
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sampleRate = sampleRate;
+        updateBandBins();
+    }
+    emit configurationChanged();
+}
+
+void SpectrumAnalyzer::setBandEdges(const QList<qreal> &bandEdges)
+{
+    if (m_bandEdges == bandEdges)
+        return;
+    if (bandEdges.size() < 2) {
+        qWarning() << "SpectrumAnalyzer: need at least two band edges";
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_bandEdges = bandEdges;
+        updateBandBins();
+    }
+    emit configurationChanged();
+    emit bandPowersChanged();
+}
+
+void SpectrumAnalyzer::setHistoryLength(int historyLength)
+{
+    if (m_historyLength == historyLength || historyLength < 1)
+        return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_historyLength = historyLength;
+        m_spectrogram.fill(0, m_historyLength * binCount());
+        m_spectrogramHead = -1;
+        m_spectrogramRows = 0;
+    }
+    emit configurationChanged();
+}
+
+QList<qreal> SpectrumAnalyzer::bandPowers() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bandPowers;
+}
+
+QList<float> SpectrumAnalyzer::spectrogram() const
+{
+    QMutexLocker locker(&m_mutex);
+    const int bins = binCount();
+    QList<float> rows;
+    rows.reserve(m_spectrogramRows * bins);
+    for (int r = 0; r < m_spectrogramRows; ++r) {
+        const int row = (m_spectrogramHead - m_spectrogramRows + 1 + r + m_historyLength) % m_historyLength;
+        const float *data = m_spectrogram.constData() + row * bins;
+        rows.append(QList<float>(data, data + bins));
+    }
+    return rows;
+}
+
+double SpectrumAnalyzer::binFrequency(int bin) const
+{
+    return bin * m_sampleRate / m_windowSize;
+}
+
+bool SpectrumAnalyzer::process(RingSample &sample)
+{
+    addSample(sample.timestamp, sample.accel);
+    return true;
+}
+
+void SpectrumAnalyzer::addSample(qint64 timestamp, QVector3D accelVector)
+{
+    bool hop;
+    {
+        QMutexLocker locker(&m_mutex);
+        hop = ingest(accelVector);
+    }
+    if (hop) {
+        runOnOwnerThread(this, [this, timestamp]() {
+            emit bandPowersChanged();
+            emit spectrogramUpdated(timestamp);
+        });
+    }
+}
+
+void SpectrumAnalyzer::reset()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        clear();
+    }
+    emit bandPowersChanged();
+}
+
+bool SpectrumAnalyzer::ingest(const QVector3D &accelVector)
+{
+    for (int c = 0; c < 3; ++c)
+        m_history[c][m_writePos] = accelVector[c];
+    m_writePos = (m_writePos + 1) % m_windowSize;
+    m_filled = qMin(m_filled + 1, m_windowSize);
+
+    if (m_filled < m_windowSize || ++m_sinceHop < m_hopSize)
+        return false;
+    m_sinceHop = 0;
+    processHop();
+    return true;
+}
+
+void SpectrumAnalyzer::clear()
+{
+    m_writePos = 0;
+    m_filled = 0;
+    m_sinceHop = 0;
+    m_spectrogram.fill(0);
+    m_spectrogramHead = -1;
+    m_spectrogramRows = 0;
+    m_bandPowers.fill(0);
+}
+
+void SpectrumAnalyzer::reconfigure()
+{
+    const int n = m_windowSize;
+    m_fft.setSize(n);
+    m_realFft.setSize(n / 2);
+
+    // Hann window, and its power for normalization.
+    m_window.resize(n);
+    m_windowPower = 0;
+    for (int i = 0; i < n; ++i) {
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * M_PI * i / n));
+        m_windowPower += m_window[i] * m_window[i];
+    }
+
+    for (int c = 0; c < 3; ++c)
+        m_history[c].fill(0, n);
+    m_re[0].fill(0, n);
+    m_im[0].fill(0, n);
+    m_z.fill(0, n);
+    m_re[1].fill(0, binCount());
+    m_im[1].fill(0, binCount());
+    m_power.fill(0, binCount());
+    m_spectrogram.fill(0, m_historyLength * binCount());
+
+    updateBandBins();
+    clear();
+}
+
+void SpectrumAnalyzer::updateBandBins()
+{
+    const int bands = m_bandEdges.size() - 1;
+    const double binHz = m_sampleRate / m_windowSize;
+
+    m_bandFirstBin.resize(bands);
+    m_bandLastBin.resize(bands);
+    for (int b = 0; b < bands; ++b) {
+        m_bandFirstBin[b] = qBound(0, int(std::ceil(m_bandEdges[b] / binHz)), binCount());
+        // The top band includes the Nyquist bin when its edge reaches it.
+        const double upper = m_bandEdges[b + 1] / binHz;
+        m_bandLastBin[b] = qBound(m_bandFirstBin[b],
+                                  upper >= binCount() - 1 ? binCount() : int(std::ceil(upper)),
+                                  binCount());
+    }
+    m_bandPowers.resize(bands);
+}
+
+void SpectrumAnalyzer::processHop()
+{
+    const int n = m_windowSize;
+    const float *window = m_window.constData();
+
+    // Oldest sample first; m_writePos is the oldest slot once the window is full.
+    float mean[3];
+    for (int c = 0; c < 3; ++c) {
+        float sum = 0;
+        for (float v : std::as_const(m_history[c]))
+            sum += v;
+        mean[c] = sum / n;
+    }
+
+    float *re0 = m_re[0].data();
+    float *im0 = m_im[0].data();
+    float *zw = m_z.data();
+    const int split = n - m_writePos;
+    for (int part = 0; part < 2; ++part) {
+        const int from = part == 0 ? m_writePos : 0;
+        const int count = part == 0 ? split : m_writePos;
+        const int offset = part == 0 ? 0 : split;
+        const float *x = m_history[0].constData() + from;
+        const float *y = m_history[1].constData() + from;
+        const float *z = m_history[2].constData() + from;
+        for (int i = 0; i < count; ++i) {
+            const float w = window[offset + i];
+            re0[offset + i] = (x[i] - mean[0]) * w;
+            im0[offset + i] = (y[i] - mean[1]) * w;
+            zw[offset + i] = (z[i] - mean[2]) * w;
+        }
+    }
+
+    m_fft.transform(re0, im0);
+    float *re1 = m_re[1].data();
+    float *im1 = m_im[1].data();
+    m_realFft.transformReal(zw, re1, im1);
+
+    // x and y share the first transform: |X_k|^2 + |Y_k|^2 = (|A_k|^2 + |A_{n-k}|^2) / 2.
+    // Scaled so the bins sum to the mean square of the windowed signal (one-sided).
+    const int bins = binCount();
+    const float scale = 1.0f / (n * m_windowPower);
+    float *power = m_power.data();
+    for (int k = 0; k < bins; ++k) {
+        const int mirror = (n - k) % n;
+        const float xy = 0.5f * (re0[k] * re0[k] + im0[k] * im0[k] + re0[mirror] * re0[mirror] + im0[mirror] * im0[mirror]);
+        const float zz = re1[k] * re1[k] + im1[k] * im1[k];
+        const float oneSided = (k == 0 || k == n / 2) ? 1.0f : 2.0f;
+        power[k] = (xy + zz) * scale * oneSided;
+    }
+
+    m_spectrogramHead = (m_spectrogramHead + 1) % m_historyLength;
+    m_spectrogramRows = qMin(m_spectrogramRows + 1, m_historyLength);
+    float *row = m_spectrogram.data() + m_spectrogramHead * bins;
+    for (int k = 0; k < bins; ++k)
+        row[k] = 10.0f * std::log10(power[k] + 1e-12f);
+
+    for (int b = 0; b < m_bandPowers.size(); ++b) {
+        float sum = 0;
+        for (int k = m_bandFirstBin[b]; k < m_bandLastBin[b]; ++k)
+            sum += power[k];
+        m_bandPowers[b] = sum;
+    }
+}
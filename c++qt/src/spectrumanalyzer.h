@@ -0,0 +1,121 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QVariantList>
+#include <QVector3D>
+#include <qqmlintegration.h>
+#include "fft.h"
+#include "processinggraph.h"
+
+// Streaming short-time Fourier transform of the accelerometer.
+//
+// Every hopSize samples the last windowSize samples of each axis are
+// detrended (mean removed, which drops gravity), Hann windowed and
+// transformed. The power of the three axes is summed per bin so the result
+// does not depend on how the ring is oriented. Each hop appends one row to a
+// rolling spectrogram and updates the power in each of the configured bands.
+//
+// All buffers are allocated when the configuration changes; a hop does no
+// allocation. Samples come either from addSample() or, when attached to the
+// processing graph, from process() on a worker thread.
+class SpectrumAnalyzer : public QObject, public ProcessingStage
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_INTERFACES(ProcessingStage)
+    Q_PROPERTY(int windowSize READ windowSize WRITE setWindowSize NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(int hopSize READ hopSize WRITE setHopSize NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(double sampleRate READ sampleRate WRITE setSampleRate NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(QList<qreal> bandEdges READ bandEdges WRITE setBandEdges NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(int historyLength READ historyLength WRITE setHistoryLength NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(int binCount READ binCount NOTIFY configurationChanged FINAL)
+    Q_PROPERTY(QList<qreal> bandPowers READ bandPowers NOTIFY bandPowersChanged FINAL)
+
+public:
+    explicit SpectrumAnalyzer(QObject *parent = nullptr);
+    ~SpectrumAnalyzer();
+
+    int windowSize() const { return m_windowSize; }
+    void setWindowSize(int windowSize);
+    int hopSize() const { return m_hopSize; }
+    void setHopSize(int hopSize);
+    double sampleRate() const { return m_sampleRate; }
+    void setSampleRate(double sampleRate);
+    // Band i covers [bandEdges[i], bandEdges[i+1]) Hz.
+    QList<qreal> bandEdges() const { return m_bandEdges; }
+    void setBandEdges(const QList<qreal> &bandEdges);
+    int historyLength() const { return m_historyLength; }
+    void setHistoryLength(int historyLength);
+    int binCount() const { return m_windowSize / 2 + 1; }
+    QList<qreal> bandPowers() const;
+
+    // Spectrogram rows, oldest first, each binCount power values (dB).
+    Q_INVOKABLE QList<float> spectrogram() const;
+    Q_INVOKABLE double binFrequency(int bin) const;
+
+    // For consumers in C++: the spectrogram is a ring of historyLength rows of
+    // binCount floats; the most recent row is at spectrogramHead(). Hold
+    // mutex() while reading it.
+    const float *spectrogramData() const { return m_spectrogram.constData(); }
+    int spectrogramHead() const { return m_spectrogramHead; }
+    int spectrogramRows() const { return m_spectrogramRows; }
+    QMutex *mutex() const { return &m_mutex; }
+
+    bool process(RingSample &sample) override;
+
+public slots:
+    void addSample(qint64 timestamp, QVector3D accelVector);
+    void reset();
+
+signals:
+    void configurationChanged();
+    void bandPowersChanged();
+    void spectrogramUpdated(qint64 timestamp);
+
+private:
+    // These expect m_mutex to be held.
+    bool ingest(const QVector3D &accelVector);
+    void reconfigure();
+    void clear();
+    void updateBandBins();
+    void processHop();
+
+    mutable QMutex m_mutex;
+
+    int m_windowSize = 64;
+    int m_hopSize = 16;
+    double m_sampleRate = 25.0;
+    QList<qreal> m_bandEdges = { 0.3, 3.0, 8.0, 12.5 }; // Activity, tremor, vibration
+    int m_historyLength = 128;
+
+    Fft m_fft;
+    Fft m_realFft; // Half the window size, for z alone
+    QList<float> m_window;
+    float m_windowPower = 1;
+
+    // Last windowSize samples per axis, circular.
+    QList<float> m_history[3];
+    int m_writePos = 0;
+    int m_filled = 0;
+    int m_sinceHop = 0;
+
+    // FFT work buffers: (x + iy) in one complex transform, m_z in a real
+    // one with the spectrum in m_re[1] and m_im[1].
+    QList<float> m_re[2];
+    QList<float> m_im[2];
+    QList<float> m_z;
+    QList<float> m_power;
+
+    QList<float> m_spectrogram;
+    int m_spectrogramHead = -1;
+    int m_spectrogramRows = 0;
+
+    QList<int> m_bandFirstBin;
+    QList<int> m_bandLastBin;
+    QList<qreal> m_bandPowers;
+};
+
+#endif // SPECTRUMANALYZER_H
@@ -0,0 +1,69 @@
+#include "clockcheck.h"
+#include "clockmodel.h"
+#include <QDebug>
+#include <QRandomGenerator>
+#include <cmath>
+
+namespace {
+const double NOMINAL_PERIOD_MS = 40.0;
+const qint64 SAMPLE_COUNT = 25 * 3600;      // An hour at 25 Hz
+const double DRIFT_TOLERANCE_PPM = 15.0;
+const qint64 UNNOTICED_SAMPLES = 100;       // Losses this close to either end can go unnoticed
+const double DELIVERY_JITTER_MS = 2.0;
+
+// One simulated stream; false with a warning if the model got it wrong.
+bool checkStream(double intervalMs, double lossRate, double driftPpm, QRandomGenerator &random)
+{
+    ClockModel model;
+    model.setNominalPeriodMs(NOMINAL_PERIOD_MS);
+    const double periodMs = NOMINAL_PERIOD_MS * (1 + driftPpm * 1e-6);
+    const double phaseMs = random.generateDouble() * intervalMs;
+    const double startMs = 1000 + random.generateDouble() * 1000;
+
+    qint64 lost = 0;
+    qint64 noticeable = 0;
+    for (qint64 i = 0; i < SAMPLE_COUNT; ++i) {
+        if (random.generateDouble() < lossRate) {
+            lost++;
+            noticeable += i >= UNNOTICED_SAMPLES && i < SAMPLE_COUNT - UNNOTICED_SAMPLES;
+            continue;
+        }
+        const double sentMs = startMs + i * periodMs;
+        const double eventMs = std::ceil((sentMs - phaseMs) / intervalMs) * intervalMs + phaseMs;
+        model.addArrival(eventMs + random.generateDouble() * DELIVERY_JITTER_MS);
+    }
+
+    const QString what = QString("interval %1 ms, %2% lost, drift %3 ppm")
+                             .arg(intervalMs).arg(lossRate * 100).arg(driftPpm);
+    if (std::abs(model.driftPpm() - driftPpm) > DRIFT_TOLERANCE_PPM) {
+        qWarning() << "Clock check:" << what << "reads" << model.driftPpm() << "ppm";
+        return false;
+    }
+    if (model.lostCount() < noticeable || model.lostCount() > lost) {
+        qWarning() << "Clock check:" << what << "found" << model.lostCount() << "lost samples of" << lost;
+        return false;
+    }
+    if (model.relockCount() != 0) {
+        qWarning() << "Clock check:" << what << "restarted the fit" << model.relockCount() << "times";
+        return false;
+    }
+    return true;
+}
+}
+
+int checkClockModel()
+{
+    QRandomGenerator random(0x5202);
+    int streams = 0;
+    for (double intervalMs : { 7.5, 45.0, 90.0 }) {
+        for (double lossRate : { 0.0, 0.001, 0.01 }) {
+            for (double driftPpm : { 0.0, 50.0, -120.0 }) {
+                if (!checkStream(intervalMs, lossRate, driftPpm, random))
+                    return 1;
+                streams++;
+            }
+        }
+    }
+    qInfo() << "Clock check: passed," << streams << "simulated hours";
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef CLOCKCHECK_H
+#define CLOCKCHECK_H
+
+// Accuracy check of ClockModel, run by testR02DataExplorer --check-clock.
+//
+// Simulates an hour of the ring's 25 Hz stream for several combinations of
+// BLE connection interval, lost notifications and ring clock drift: every
+// sample arrives at the first connection event after it was sent, a little
+// late, unless it was lost. Checks that driftPpm() ends up close to the
+// simulated drift, that lostCount() found the samples that went missing, and
+// that nothing short of a dropout restarted the fit.
+//
+// Returns 0 when every combination passes.
+int checkClockModel();
+
+#endif // CLOCKCHECK_H
@@ -0,0 +1,191 @@
+#include "indexcheck.h"
+#include "recordingindex.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const qint64 START_MS = 1700000000037;  // Deliberately not bucket aligned
+const int SAMPLE_COUNT = 100000;
+const int QUERIES_PER_CHECK = 60;
+const double MEAN_TOLERANCE = 0.5;      // Float sums of up to ~10^5 samples
+
+struct Sample {
+    qint64 timestampMs;
+    QVector3D accel;
+};
+
+// Which index buckets query() reads, and which output entry each lands in,
+// is part of its contract; the brute force follows the same rules but
+// summarises the raw samples instead of the index.
+bool compareQuery(RecordingIndex &index, const QList<Sample> &samples, qint64 fromMs, qint64 toMs,
+                  int buckets, const QString &what)
+{
+    const QList<RecordingIndex::Summary> result = index.query(fromMs, toMs, buckets);
+    if (result.size() != buckets) {
+        qWarning() << what << "query returned" << result.size() << "entries instead of" << buckets;
+        return false;
+    }
+
+    const double pixelMs = double(toMs - fromMs) / buckets;
+    qint64 bucketMs = RecordingIndex::BASE_BUCKET_MS;
+    for (int level = 1; level < RecordingIndex::LEVELS && bucketMs * RecordingIndex::FANOUT <= pixelMs; ++level)
+        bucketMs *= RecordingIndex::FANOUT;
+
+    const qint64 startMs = index.startMs();
+    const qint64 first = qMax<qint64>(0, (fromMs - startMs) / bucketMs);
+    const qint64 last = (toMs - startMs + bucketMs - 1) / bucketMs;
+
+    QList<quint32> count(buckets, 0);
+    QList<QVector3D> min(buckets, QVector3D(1e9f, 1e9f, 1e9f));
+    QList<QVector3D> max(buckets, QVector3D(-1e9f, -1e9f, -1e9f));
+    QList<double> sum(buckets * 3, 0.0);
+
+    auto it = std::lower_bound(samples.cbegin(), samples.cend(), startMs + first * bucketMs,
+                               [](const Sample &sample, qint64 t) { return sample.timestampMs < t; });
+    for (; it != samples.cend() && it->timestampMs < startMs + last * bucketMs; ++it) {
+        const qint64 bucketStart = startMs + (it->timestampMs - startMs) / bucketMs * bucketMs;
+        const int out = qBound<qint64>(0, qint64((bucketStart - fromMs) / pixelMs), buckets - 1);
+        count[out]++;
+        for (int c = 0; c < 3; ++c) {
+            min[out][c] = qMin(min[out][c], it->accel[c]);
+            max[out][c] = qMax(max[out][c], it->accel[c]);
+            sum[out * 3 + c] += it->accel[c];
+        }
+    }
+
+    for (int i = 0; i < buckets; ++i) {
+        const RecordingIndex::Summary &summary = result.at(i);
+        bool ok = summary.count == count.at(i);
+        for (int c = 0; ok && count.at(i) > 0 && c < 3; ++c) {
+            ok = summary.min[c] == min.at(i)[c] && summary.max[c] == max.at(i)[c]
+                 && std::abs(summary.mean[c] - sum.at(i * 3 + c) / count.at(i)) <= MEAN_TOLERANCE;
+        }
+        if (!ok) {
+            qWarning().nospace() << what << ": query(" << fromMs - startMs << ", " << toMs - startMs << ", "
+                                 << buckets << ") entry " << i << " has count " << summary.count << " min "
+                                 << summary.min << " max " << summary.max << " mean " << summary.mean
+                                 << ", expected count " << count.at(i) << " min " << min.at(i) << " max "
+                                 << max.at(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool compareQueries(RecordingIndex &index, const QList<Sample> &samples, QRandomGenerator &random,
+                    const QString &what)
+{
+    const qint64 startMs = index.startMs();
+    const qint64 endMs = samples.constLast().timestampMs + 1;
+    const qint64 total = endMs - startMs;
+
+    if (!compareQuery(index, samples, startMs, endMs, 1, what)
+        || !compareQuery(index, samples, startMs, endMs, 300, what))
+        return false;
+
+    for (int i = 0; i < QUERIES_PER_CHECK; ++i) {
+        // Spans from a second to a bit more than the whole recording, log uniform.
+        const qint64 span = qint64(1000 * std::pow(total * 1.2 / 1000, random.generateDouble())) + 1;
+        const qint64 fromMs = startMs - 3600000 + qint64(random.generateDouble() * (total + 3600000));
+        const int buckets = 1 + random.bounded(500);
+        if (!compareQuery(index, samples, fromMs, fromMs + span, buckets, what))
+            return false;
+    }
+    return true;
+}
+
+bool copyIndex(const QString &fromCapture, const QString &toCapture)
+{
+    const QDir from(RecordingIndex::indexDirFor(fromCapture));
+    const QDir to(RecordingIndex::indexDirFor(toCapture));
+    if (!QDir().mkpath(to.path()))
+        return false;
+    for (const QString &name : from.entryList(QDir::Files)) {
+        QFile::remove(to.filePath(name));
+        if (!QFile::copy(from.filePath(name), to.filePath(name)))
+            return false;
+    }
+    return true;
+}
+}
+
+int checkRecordingIndex()
+{
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "Index check: cannot create a temporary directory";
+        return 2;
+    }
+    const QString capture = dir.filePath("check.csv");
+    const QString killed = dir.filePath("killed.csv");
+
+    RecordingIndex writer;
+    if (!writer.create(capture, START_MS)) {
+        qWarning() << "Index check:" << writer.errorString();
+        return 2;
+    }
+
+    // Mostly a sample every 40 ms to a few seconds, now and then a gap of up
+    // to two hours; about three days in all, so level 7 gets a second bucket.
+    QRandomGenerator random(0x5202);
+    QList<Sample> samples;
+    samples.reserve(SAMPLE_COUNT);
+    qint64 timestampMs = START_MS;
+    const QList<int> checkpoints = { 10, 1000, 30000, 70000 };
+
+    for (int i = 1; i <= SAMPLE_COUNT; ++i) {
+        timestampMs += random.bounded(2500) == 0 ? random.bounded(2 * 3600000) : 40 + random.bounded(2500);
+        const QVector3D accel(random.bounded(-2048, 2048), random.bounded(-2048, 2048), random.bounded(-2048, 2048));
+        samples.append({ timestampMs, accel });
+        writer.append(timestampMs, accel);
+
+        if (!checkpoints.contains(i))
+            continue;
+
+        if (!compareQueries(writer, samples, random, QString("writer after %1 samples").arg(i)))
+            return 1;
+
+        // As if the app was killed right after a flush: the copy must be complete.
+        writer.flush();
+        RecordingIndex reader;
+        if (!copyIndex(capture, killed) || !reader.open(killed)) {
+            qWarning() << "Index check: cannot open a copy of the index" << reader.errorString();
+            return 2;
+        }
+        if (!compareQueries(reader, samples, random, QString("flushed copy after %1 samples").arg(i)))
+            return 1;
+        reader.close();
+
+        // Coarse levels lagging behind level 0 are rebuilt by open().
+        const QDir killedDir(RecordingIndex::indexDirFor(killed));
+        QFile level1(killedDir.filePath("L1.bin"));
+        QFile level4(killedDir.filePath("L4.bin"));
+        level1.resize(32);
+        level4.resize(qMax<qint64>(32, level4.size() - qint64(sizeof(RecordingIndex::Bucket))));
+        if (!reader.open(killed)) {
+            qWarning() << "Index check: cannot open the truncated copy" << reader.errorString();
+            return 2;
+        }
+        if (!compareQueries(reader, samples, random, QString("truncated copy after %1 samples").arg(i)))
+            return 1;
+    }
+
+    writer.close();
+    RecordingIndex reader;
+    if (!reader.open(capture)) {
+        qWarning() << "Index check:" << reader.errorString();
+        return 2;
+    }
+    if (!compareQueries(reader, samples, random, "closed index"))
+        return 1;
+
+    qInfo() << "Index check: passed," << samples.size() << "samples over"
+            << (timestampMs - START_MS) / 3600000 << "hours";
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef INDEXCHECK_H
+#define INDEXCHECK_H
+
+// Consistency check of RecordingIndex, run by testR02DataExplorer --check-index.
+//
+// Builds an index over a few days of sparse random samples with gaps, and at
+// several points compares query() at random ranges and resolutions against a
+// brute-force min/max/mean over the samples themselves: while writing (partial
+// buckets merged in memory), on a copy taken after flush() as if the writer
+// had been killed, on that copy with coarse levels truncated (rebuilt by
+// open()), and after close().
+//
+// Returns 0 when everything matches.
+int checkRecordingIndex();
+
+#endif // INDEXCHECK_H
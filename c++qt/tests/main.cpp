@@ -0,0 +1,72 @@
+// Colmi R02 Qt C++ Data Explorer App
+//
+// Copyright (C) 2025 Keith Kyzivat <keithel @ github>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+// Self-checks of the app's code, run by ctest; not part of the app itself.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include "clockcheck.h"
+#include "indexcheck.h"
+#include "processinggraph.h"
+#include "soakharness.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption checkIndexOption("check-index",
+                                        "Check the recording index against a brute-force summary.");
+    parser.addOption(checkIndexOption);
+    QCommandLineOption checkClockOption("check-clock",
+                                        "Check the sample clock model against simulated BLE streams.");
+    parser.addOption(checkClockOption);
+    QCommandLineOption soakOption("soak",
+                                  "Run the long-run soak test over this many simulated hours.",
+                                  "hours");
+    parser.addOption(soakOption);
+    QCommandLineOption replayOption("replay",
+                                    "Feed the soak test the payloads of a CSV recorded by ring.py.",
+                                    "file");
+    parser.addOption(replayOption);
+    QCommandLineOption pipelineOption("pipeline",
+                                      "Processing graph configuration (JSON) for the soak test.",
+                                      "file");
+    parser.addOption(pipelineOption);
+    parser.process(app);
+    if (parser.isSet(pipelineOption))
+        ProcessingGraph::setConfigFile(parser.value(pipelineOption));
+
+    if (parser.isSet(checkIndexOption))
+        return checkRecordingIndex();
+    if (parser.isSet(checkClockOption))
+        return checkClockModel();
+
+    if (parser.isSet(soakOption)) {
+        bool ok = false;
+        const int hours = parser.value(soakOption).toInt(&ok);
+        if (!ok || hours <= 0) {
+            qWarning() << "--soak expects a number of hours";
+            return 2;
+        }
+        return SoakHarness(hours, parser.value(replayOption)).run();
+    }
+
+    parser.showHelp(2);
+}
@@ -0,0 +1,354 @@
+#include "soakharness.h"
+#include "datarecorder.h"
+#include "ringconnector.h"
+#include "spectrumanalyzer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QEvent>
+#include <QEventLoop>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QScopeGuard>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QtMath>
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+const double TIME_SCALE = 500;          // A simulated hour takes 7.2 s, all intervals stay whole ms
+const double HOUR_MS = 3600000.0;
+const double PACKET_PERIOD_MS = 40.0;   // 25 Hz
+const double MAX_JITTER_MS = 15.0;      // Notifications arrive late, never early
+const int CONNECTED_HOURS = 6;
+const int IDLE_HOURS = 1;
+const double DISCHARGE_MS = 2 * 3600000.0; // 1% of battery
+const int BATCH_PACKETS = 200;          // Below the spectrum queue, so nothing is dropped
+const int STEADY_POLLS_PER_HOUR = 12;   // A tenth of polling at the fast rate
+const int WARMUP_HOURS = 2;
+const qint64 MAX_RSS_GROWTH = 4 * 1024 * 1024;
+}
+
+SoakHarness::SoakHarness(int hours, const QString &replayFile)
+    : m_hours(hours),
+    m_replayFile(replayFile)
+{
+}
+
+int SoakHarness::run()
+{
+    // The connector logs the packet rate on every tick, days of that is just noise.
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    if (m_replayFile.isEmpty())
+        makeSyntheticPackets();
+    else if (!loadReplay())
+        return 2;
+
+    RingConnector connector;
+    connector.setAllowAutoreconnect(false);
+    connector.setTimeScale(TIME_SCALE);
+    SpectrumAnalyzer spectrum;
+    connector.attachStage("spectrum", &spectrum);
+
+    // Recording is what's left running for days. It goes to the test-mode
+    // data directory and is removed again at the end.
+    QStandardPaths::setTestModeEnabled(true);
+    DataRecorder recorder;
+    connector.attachStage("recorder", &recorder);
+    connect(&recorder, &DataRecorder::error, this, [this](const QString &message) {
+        qWarning() << "Soak: recorder:" << message;
+        m_recorderErrors++;
+    });
+    recorder.setRecording(true);
+    if (!recorder.recording())
+        return 2;
+    const QString recording = recorder.fileName();
+    const auto removeRecording = qScopeGuard([&recorder, &recording]() {
+        recorder.setRecording(false);
+        QFile::remove(recording);
+        QDir(RecordingIndex::indexDirFor(recording)).removeRecursively();
+    });
+
+    // Count what really fires. Connected after the connector's own slots, so
+    // a battery poll has been sent by the time it's answered here.
+    for (QTimer *timer : { connector.m_batteryRequestTimer, connector.m_packetRateTimer, connector.m_reconnectTimer })
+        connect(timer, &QTimer::timeout, this, [this]() { m_timerWakeups++; });
+    connect(connector.m_batteryRequestTimer, &QTimer::timeout, this, [this, &connector]() {
+        m_batteryPolls++;
+        connector.parsePacket(batteryPacket(m_batteryLevel), virtualNow());
+    });
+    QCoreApplication::instance()->installEventFilter(this);
+
+    if (connector.armedTimerCount() != 0) {
+        qWarning() << "Soak: timers armed before connecting";
+        return 1;
+    }
+
+    qInfo().noquote() << QString("Soak: %1 h at %2x, %3 h connected / %4 h idle, %5 packets from %6")
+                             .arg(m_hours).arg(TIME_SCALE).arg(CONNECTED_HOURS).arg(IDLE_HOURS)
+                             .arg(m_packets.size())
+                             .arg(m_replayFile.isEmpty() ? QString("synthetic stream") : m_replayFile);
+
+    m_wallClock.start();
+    for (m_hour = 0; m_hour < m_hours; m_hour++) {
+        const bool connected = m_hour % (CONNECTED_HOURS + IDLE_HOURS) < CONNECTED_HOURS;
+        if (connected && !connector.m_streaming) {
+            // Charged while it was off the finger. Connecting polls the
+            // battery right away, answer that one too.
+            m_batteryLevel = 100;
+            m_nextDischargeMs = virtualNow() + DISCHARGE_MS;
+            m_nextPacketMs = virtualNow();
+            connector.startStreamTimers();
+            connector.parsePacket(batteryPacket(m_batteryLevel), virtualNow());
+            m_levelChanged = true;
+        }
+        else if (!connected && connector.m_streaming) {
+            connector.controllerDisconnected();
+        }
+
+        runHour(connector, connected);
+        if (!endHour(connector, connected, spectrum.hopSize()))
+            return 1;
+    }
+
+    QCoreApplication::instance()->removeEventFilter(this);
+    recorder.setRecording(false);
+    if (recorder.endTime() <= recorder.startTime()) {
+        qWarning() << "Soak: nothing was recorded";
+        return 1;
+    }
+    qInfo().noquote() << QString("Soak: passed, %1 h recorded, peak RSS %2 KiB")
+                             .arg((recorder.endTime() - recorder.startTime()) / HOUR_MS, 0, 'f', 1)
+                             .arg(m_peakRss / 1024);
+    return 0;
+}
+
+bool SoakHarness::eventFilter(QObject *watched, QEvent *event)
+{
+    // Queued calls, e.g. from runOnOwnerThread(), each wake up the GUI thread.
+    if (event->type() == QEvent::MetaCall)
+        m_queuedCalls++;
+    return QObject::eventFilter(watched, event);
+}
+
+double SoakHarness::virtualNow() const
+{
+    // Stands in for the connector's monotonic host clock.
+    return m_wallClock.nsecsElapsed() / 1e6 * TIME_SCALE;
+}
+
+void SoakHarness::runHour(RingConnector &connector, bool connected)
+{
+    const double endMs = (m_hour + 1) * HOUR_MS;
+    QEventLoop loop;
+    QTimer pace;
+    pace.setSingleShot(true);
+    pace.setTimerType(Qt::PreciseTimer);
+    connect(&pace, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    double now;
+    while ((now = virtualNow()) < endMs) {
+        if (!connected) {
+            // Sleep through the hour, anything the connector wakes up for is counted.
+            pace.start(qMax(1, qCeil((endMs - now) / TIME_SCALE)));
+            loop.exec();
+            continue;
+        }
+
+        if (now >= m_nextDischargeMs) {
+            m_batteryLevel = qMax(1, m_batteryLevel - 1);
+            m_nextDischargeMs += DISCHARGE_MS;
+            m_levelChanged = true;
+        }
+
+        int fed = 0;
+        while (m_nextPacketMs <= now && m_nextPacketMs < endMs && fed < BATCH_PACKETS) {
+            const double jitter = m_random.bounded(MAX_JITTER_MS);
+            connector.parsePacket(m_packets[m_nextPacket], m_nextPacketMs + jitter);
+            m_nextPacket = (m_nextPacket + 1) % m_packets.size();
+            m_nextPacketMs += PACKET_PERIOD_MS;
+            fed++;
+        }
+        m_packetsFed += fed;
+        connector.m_graph.waitForIdle();
+
+        if (fed < BATCH_PACKETS) {
+            // Caught up with the simulated clock, wait for it in the event loop.
+            pace.start(1);
+            loop.exec();
+        }
+        else {
+            QCoreApplication::processEvents();
+        }
+    }
+
+    if (connected) {
+        // If feeding couldn't keep up, skip what's left of this hour's stream.
+        m_packetsSkipped += qMax(0, int((endMs - m_nextPacketMs) / PACKET_PERIOD_MS));
+        m_nextPacketMs = qMax(m_nextPacketMs, endMs);
+    }
+    connector.m_graph.waitForIdle();
+    QCoreApplication::processEvents();
+}
+
+bool SoakHarness::endHour(RingConnector &connector, bool connected, int hopSize)
+{
+    bool ok = true;
+    if (!connected) {
+        if (connector.armedTimerCount() != 0 || m_timerWakeups != 0 || m_queuedCalls != 0) {
+            qWarning() << "Soak: hour" << m_hour << "idle, but" << connector.armedTimerCount() << "timers armed,"
+                       << m_timerWakeups << "fired and" << m_queuedCalls << "queued calls delivered";
+            ok = false;
+        }
+    }
+    else {
+        // The packet-rate tick, and the battery polled at its fastest.
+        const int maxWakeups = int(HOUR_MS / connector.PACKET_RATE_INTERVAL_MS
+                                   + HOUR_MS / connector.BATTERY_POLL_MIN_MS);
+        if (m_timerWakeups > maxWakeups) {
+            qWarning() << "Soak: hour" << m_hour << "fired" << m_timerWakeups << "timers, more than" << maxWakeups;
+            ok = false;
+        }
+        // The spectrum notifies the GUI thread once per hop and the recorder
+        // once per flush, nothing else should.
+        const int maxQueuedCalls = m_packetsFed / hopSize
+                                   + int(m_packetsFed * PACKET_PERIOD_MS / DataRecorder::FLUSH_INTERVAL_MS) + 2;
+        if (m_queuedCalls > maxQueuedCalls) {
+            qWarning() << "Soak: hour" << m_hour << "queued" << m_queuedCalls << "calls for"
+                       << m_packetsFed << "packets, more than" << maxQueuedCalls;
+            ok = false;
+        }
+        if (!m_levelChanged && m_batteryLevel > connector.LOW_BATTERY_LEVEL
+            && m_batteryPolls > STEADY_POLLS_PER_HOUR) {
+            qWarning() << "Soak: hour" << m_hour << "polled a steady battery" << m_batteryPolls << "times, more than"
+                       << STEADY_POLLS_PER_HOUR;
+            ok = false;
+        }
+    }
+
+    if (m_recorderErrors > 0)
+        ok = false;
+
+    const qint64 rss = residentBytes();
+    if (rss >= 0) {
+        m_peakRss = qMax(m_peakRss, rss);
+        if (m_hour + 1 == WARMUP_HOURS) {
+            m_baselineRss = rss;
+        }
+        else if (m_baselineRss >= 0 && rss - m_baselineRss > MAX_RSS_GROWTH) {
+            qWarning() << "Soak: hour" << m_hour << "RSS grew from" << m_baselineRss / 1024
+                       << "KiB to" << rss / 1024 << "KiB";
+            ok = false;
+        }
+    }
+
+    qInfo().noquote() << QString("Soak: hour %1 %2: %3 packets (%4 skipped), %5 timer wakeups, %6 battery polls, "
+                                 "%7 queued calls, battery %8%, RSS %9 KiB")
+                             .arg(m_hour).arg(connected ? "connected" : "idle").arg(m_packetsFed)
+                             .arg(m_packetsSkipped).arg(m_timerWakeups).arg(m_batteryPolls).arg(m_queuedCalls)
+                             .arg(m_batteryLevel).arg(rss >= 0 ? QString::number(rss / 1024) : QString("n/a"));
+    m_packetsFed = 0;
+    m_packetsSkipped = 0;
+    m_timerWakeups = 0;
+    m_batteryPolls = 0;
+    m_queuedCalls = 0;
+    m_levelChanged = false;
+    return ok;
+}
+
+bool SoakHarness::loadReplay()
+{
+    // A CSV written by ring.py, the packets are hex in the payload column.
+    QFile file(m_replayFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Soak: cannot open" << m_replayFile << file.errorString();
+        return false;
+    }
+
+    const int column = QString::fromUtf8(file.readLine()).trimmed().split(',').indexOf("payload");
+    if (column < 0) {
+        qWarning() << "Soak:" << m_replayFile << "has no payload column";
+        return false;
+    }
+
+    while (!file.atEnd()) {
+        const QList<QByteArray> fields = file.readLine().trimmed().split(',');
+        if (fields.size() <= column)
+            continue;
+        const QByteArray packet = QByteArray::fromHex(fields[column]);
+        // The harness answers battery polls itself.
+        if (packet.size() >= 3 && static_cast<quint8>(packet[0]) != 0x03)
+            m_packets.append(packet);
+    }
+
+    if (m_packets.isEmpty()) {
+        qWarning() << "Soak: no packets in" << m_replayFile;
+        return false;
+    }
+    return true;
+}
+
+void SoakHarness::makeSyntheticPackets()
+{
+    // A minute of accelerometer packets: slow arm movement, some tremor and
+    // gravity on z.
+    const int count = int(60000 / PACKET_PERIOD_MS);
+    m_packets.reserve(count);
+    for (int i = 0; i < count; i++) {
+        const double t = i * PACKET_PERIOD_MS / 1000.0;
+        const double axes[3] = {
+            200 * qSin(2 * M_PI * 1.0 * t) + 20 * qSin(2 * M_PI * 5.0 * t),
+            150 * qCos(2 * M_PI * 0.5 * t),
+            1000 + 30 * qSin(2 * M_PI * 9.0 * t),
+        };
+
+        QByteArray packet(16, 0x00);
+        packet[0] = static_cast<char>(0xA1);
+        packet[1] = static_cast<char>(0x03);
+        for (int axis = 0; axis < 3; axis++) {
+            const int value = qRound(axes[axis]) & 0xFFF;
+            packet[2 + axis * 2] = static_cast<char>(value >> 4);
+            packet[3 + axis * 2] = static_cast<char>(value & 0xF);
+        }
+        quint8 sum = 0;
+        for (int j = 0; j < 15; j++)
+            sum += static_cast<quint8>(packet[j]);
+        packet[15] = static_cast<char>(sum);
+        m_packets.append(packet);
+    }
+}
+
+QByteArray SoakHarness::batteryPacket(int level) const
+{
+    // [0x03, level, voltage_h, voltage_l, ..., checksum]
+    const int voltage = 3300 + level * 9;
+    QByteArray packet(16, 0x00);
+    packet[0] = static_cast<char>(0x03);
+    packet[1] = static_cast<char>(level);
+    packet[2] = static_cast<char>(voltage >> 8);
+    packet[3] = static_cast<char>(voltage & 0xFF);
+    quint8 sum = 0;
+    for (int j = 0; j < 15; j++)
+        sum += static_cast<quint8>(packet[j]);
+    packet[15] = static_cast<char>(sum);
+    return packet;
+}
+
+qint64 SoakHarness::residentBytes()
+{
+#ifdef Q_OS_LINUX
+    // Second field of statm: resident pages.
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
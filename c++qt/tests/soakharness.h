@@ -0,0 +1,79 @@
+#ifndef SOAKHARNESS_H
+#define SOAKHARNESS_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QList>
+#include <QRandomGenerator>
+#include <QString>
+
+class RingConnector;
+
+// Long-run check of RingConnector and the processing graph without a ring
+// or a display, run by testR02DataExplorer --soak <hours>.
+//
+// Simulates days of use: 6 hours connected and streaming at 25 Hz, then an
+// hour disconnected, over and over, with the spectrum analyzer attached and
+// a DataRecorder recording throughout. The event loop runs for real, with the
+// connector's timers TIME_SCALE times faster than normal, and packets are
+// fed to parsePacket() at the same accelerated pace. They are synthetic, or
+// taken from the payload column of a ring.py CSV (--replay). Each battery
+// poll is answered with a reply; the simulated level drops a percent every
+// DISCHARGE_MS.
+//
+// What's counted per simulated hour is what actually happened: timeout()
+// emissions of the connector's timers and queued calls delivered to the GUI
+// thread. It fails (non-zero exit code) if
+//  - anything is armed, fires or is delivered while disconnected,
+//  - a connected hour fires more timers than the packet-rate tick and the
+//    fastest battery poll allow, or queues more calls than the spectrum's
+//    hops and the recorder's flushes explain,
+//  - the recorder reports an error or records nothing,
+//  - the battery is polled anywhere near the fast rate while its level holds,
+//  - resident memory keeps growing after the warm-up (Linux only).
+class SoakHarness : public QObject
+{
+    Q_OBJECT
+
+public:
+    SoakHarness(int hours, const QString &replayFile = QString());
+
+    int run();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    bool loadReplay();
+    void makeSyntheticPackets();
+    QByteArray batteryPacket(int level) const;
+    double virtualNow() const;
+    void runHour(RingConnector &connector, bool connected);
+    bool endHour(RingConnector &connector, bool connected, int hopSize);
+    static qint64 residentBytes();
+
+    int m_hours = 0;
+    QString m_replayFile;
+    QList<QByteArray> m_packets;
+    int m_nextPacket = 0;
+    QRandomGenerator m_random { 0x5202 };
+
+    QElapsedTimer m_wallClock;
+    double m_nextPacketMs = 0;
+    int m_batteryLevel = 100;
+    double m_nextDischargeMs = 0;
+
+    int m_hour = 0;
+    int m_packetsFed = 0;
+    int m_packetsSkipped = 0;
+    int m_timerWakeups = 0;
+    int m_batteryPolls = 0;
+    int m_queuedCalls = 0;
+    int m_recorderErrors = 0;
+    bool m_levelChanged = false;
+    qint64 m_baselineRss = -1;
+    qint64 m_peakRss = 0;
+};
+
+#endif // SOAKHARNESS_H
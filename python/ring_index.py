@@ -0,0 +1,167 @@
+"""Read and build the min/max/mean pyramid index stored next to a capture.
+
+The index lives in "<capture>.csv.idx/" and is written incrementally by the
+Qt app while recording (see c++qt/src/recordingindex.h). Each level is a flat
+file "L<n>.bin": a 32 byte header followed by fixed-size buckets. Level 0
+buckets cover 100 ms, every level above covers 8 buckets of the one below.
+
+Files are memory-mapped, so querying a multi-day recording only touches the
+buckets needed for the requested resolution. The app flushes the index every
+few seconds, so a recording in progress can be read up to the last flush.
+
+    python ring_index.py raw_data/ring_data_20241118_144005.csv --buckets 20
+    python ring_index.py raw_data/ring_data_20241118_144005.csv --build
+"""
+import argparse
+import os
+from datetime import datetime
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+BASE_BUCKET_MS = 100
+FANOUT = 8
+LEVELS = 8
+MAGIC = b"R02IDX01"
+
+HEADER_DTYPE = np.dtype([("magic", "S8"), ("start_ms", "<i8"), ("bucket_ms", "<i8"), ("reserved", "<i8")])
+BUCKET_DTYPE = np.dtype([("min", "<f4", 3), ("max", "<f4", 3), ("sum", "<f4", 3), ("count", "<u4")])
+AXES = ["accX", "accY", "accZ"]
+LOCAL_TZ = datetime.now().astimezone().tzinfo
+
+
+def to_local_time(ms):
+    return pd.to_datetime(ms, unit="ms", utc=True).tz_convert(LOCAL_TZ).tz_localize(None)
+
+
+def index_dir_for(capture_path):
+    return Path(f"{capture_path}.idx")
+
+
+class RingIndex:
+    """Read-only view of a recording index."""
+
+    def __init__(self, capture_path):
+        self.levels = []
+        self.start_ms = None
+        index_dir = index_dir_for(capture_path)
+        for level in range(LEVELS):
+            path = index_dir / f"L{level}.bin"
+            header = np.fromfile(path, dtype=HEADER_DTYPE, count=1)[0]
+            if header["magic"] != MAGIC or header["bucket_ms"] != BASE_BUCKET_MS * FANOUT ** level:
+                raise ValueError(f"Invalid index file {path}")
+            self.start_ms = int(header["start_ms"])
+            count = (os.path.getsize(path) - HEADER_DTYPE.itemsize) // BUCKET_DTYPE.itemsize
+            buckets = (np.memmap(path, dtype=BUCKET_DTYPE, mode="r", offset=HEADER_DTYPE.itemsize, shape=(count,))
+                       if count else np.zeros(0, dtype=BUCKET_DTYPE))
+            self.levels.append(buckets)
+
+    @property
+    def end_ms(self):
+        return self.start_ms + len(self.levels[0]) * BASE_BUCKET_MS
+
+    def query(self, from_ms, to_ms, buckets):
+        """Summarise [from_ms, to_ms) into `buckets` rows of start, end, count, min, max and mean per axis."""
+        pixel_ms = (to_ms - from_ms) / buckets
+
+        # Coarsest level that still resolves a single output bucket
+        level = 0
+        while level + 1 < LEVELS and BASE_BUCKET_MS * FANOUT ** (level + 1) <= pixel_ms:
+            level += 1
+        bucket_ms = BASE_BUCKET_MS * FANOUT ** level
+        data = self.levels[level]
+
+        first = max(0, (from_ms - self.start_ms) // bucket_ms)
+        last = min(len(data), -(-(to_ms - self.start_ms) // bucket_ms))
+        window = data[first:last] if first < last else np.zeros(0, dtype=BUCKET_DTYPE)
+        used = np.flatnonzero(window["count"] > 0)
+        rows = window[used]
+        starts = self.start_ms + (first + used) * bucket_ms
+        out = np.clip(((starts - from_ms) / pixel_ms).astype(np.int64), 0, buckets - 1)
+
+        count = np.zeros(buckets, dtype=np.uint64)
+        vmin = np.full((buckets, 3), np.inf)
+        vmax = np.full((buckets, 3), -np.inf)
+        vsum = np.zeros((buckets, 3))
+        np.add.at(count, out, rows["count"])
+        np.minimum.at(vmin, out, rows["min"])
+        np.maximum.at(vmax, out, rows["max"])
+        np.add.at(vsum, out, rows["sum"])
+
+        result = pd.DataFrame({
+            "start": to_local_time(from_ms + (np.arange(buckets) * pixel_ms).astype(np.int64)),
+            "end": to_local_time(from_ms + (np.arange(1, buckets + 1) * pixel_ms).astype(np.int64)),
+            "count": count,
+        })
+        with np.errstate(invalid="ignore", divide="ignore"):
+            mean = vsum / count[:, None]
+        empty = count == 0
+        for i, axis in enumerate(AXES):
+            result[f"{axis}_min"] = np.where(empty, np.nan, vmin[:, i])
+            result[f"{axis}_max"] = np.where(empty, np.nan, vmax[:, i])
+            result[f"{axis}_mean"] = np.where(empty, np.nan, mean[:, i])
+        return result
+
+
+def build_index(capture_path):
+    """Build the index for an existing CSV capture (e.g. one written by ring.py)."""
+    df = pd.read_csv(capture_path, parse_dates=["timestamp"]).dropna(subset=AXES)
+    timestamps = df["timestamp"]
+    if timestamps.dt.tz is None:
+        # ring.py and the Qt app write local time without an offset
+        timestamps = timestamps.dt.tz_localize(LOCAL_TZ)
+    times = timestamps.dt.tz_convert("UTC").dt.tz_localize(None).to_numpy().astype("datetime64[ms]").astype(np.int64)
+    values = df[AXES].to_numpy(dtype=np.float64)
+    start_ms = int(times[0]) - int(times[0]) % BASE_BUCKET_MS
+
+    index_dir = index_dir_for(capture_path)
+    index_dir.mkdir(parents=True, exist_ok=True)
+
+    # Level 0 from the samples, every level above from the level below.
+    slots = (times - start_ms) // BASE_BUCKET_MS
+    level = np.zeros(int(slots[-1]) + 1, dtype=BUCKET_DTYPE)
+    level["min"] = np.finfo(np.float32).max
+    level["max"] = np.finfo(np.float32).min
+    np.add.at(level["count"], slots, 1)
+    for i in range(3):
+        np.minimum.at(level["min"][:, i], slots, values[:, i])
+        np.maximum.at(level["max"][:, i], slots, values[:, i])
+        np.add.at(level["sum"][:, i], slots, values[:, i])
+
+    for n in range(LEVELS):
+        header = np.array([(MAGIC, start_ms, BASE_BUCKET_MS * FANOUT ** n, 0)], dtype=HEADER_DTYPE)
+        with open(index_dir / f"L{n}.bin", "wb") as file:
+            header.tofile(file)
+            level.tofile(file)
+
+        parents = np.arange(len(level)) // FANOUT
+        upper = np.zeros(parents[-1] + 1, dtype=BUCKET_DTYPE)
+        upper["min"] = np.finfo(np.float32).max
+        upper["max"] = np.finfo(np.float32).min
+        np.add.at(upper["count"], parents, level["count"])
+        np.minimum.at(upper["min"], parents, level["min"])
+        np.maximum.at(upper["max"], parents, level["max"])
+        np.add.at(upper["sum"], parents, level["sum"])
+        level = upper
+
+    print(f"Index saved to {index_dir}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Query or build the pyramid index of a ring capture")
+    parser.add_argument("capture", type=str, help="Path to the capture CSV")
+    parser.add_argument("--build", action="store_true", help="(Re)build the index from the CSV")
+    parser.add_argument("--start", type=str, help="Start of the range (ISO 8601), defaults to start of recording")
+    parser.add_argument("--end", type=str, help="End of the range (ISO 8601), defaults to end of recording")
+    parser.add_argument("--buckets", type=int, default=50, help="Number of buckets to summarise the range into")
+
+    args = parser.parse_args()
+    if args.build:
+        build_index(args.capture)
+
+    index = RingIndex(args.capture)
+    start = int(datetime.fromisoformat(args.start).timestamp() * 1000) if args.start else index.start_ms
+    end = int(datetime.fromisoformat(args.end).timestamp() * 1000) if args.end else index.end_ms
+    with pd.option_context("display.max_rows", None, "display.width", None):
+        print(index.query(start, end, args.buckets))